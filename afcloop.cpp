@@ -0,0 +1,48 @@
+#include "afcloop.h"
+#include <QtGlobal>
+
+AfcLoop::AfcLoop()
+{
+    reset();
+}
+
+void AfcLoop::reset(){
+    m_integral = 0.0;
+    m_errorHz = 0.0;
+    m_correctionHz = 0.0;
+}
+
+/**
+ * @brief AfcLoop::update run one control step on a fresh tone measurement
+ * @param toneHz measured RX tone
+ * @param markHz nominal mark tone
+ * @param spaceHz nominal space tone
+ * @return true if correctionHz() changed and should be applied
+ */
+bool AfcLoop::update(double toneHz, double markHz, double spaceHz){
+    if(toneHz <= 0.0){
+        return false; // nothing received
+    }
+
+    double markErr = toneHz - markHz;
+    double spaceErr = toneHz - spaceHz;
+    double err = qAbs(markErr) < qAbs(spaceErr) ? markErr : spaceErr;
+    if(qAbs(err) > AFC_CAPTURE_HZ){
+        return false; // not one of our tones
+    }
+    m_errorHz = err;
+    if(qAbs(err) < AFC_DEADBAND_HZ){
+        return false;
+    }
+
+    m_integral += err;
+    // the integral term alone may not push past the correction limit
+    double maxIntegral = AFC_MAX_CORR_HZ/AFC_KI;
+    m_integral = qBound(-maxIntegral, m_integral, maxIntegral);
+
+    double target = -(AFC_KP*err + AFC_KI*m_integral)/AFC_TONE_SENSE;
+    target = qBound(-AFC_MAX_CORR_HZ, target, AFC_MAX_CORR_HZ);
+    double step = qBound(-AFC_MAX_STEP_HZ, target - m_correctionHz, AFC_MAX_STEP_HZ);
+    m_correctionHz += step;
+    return step != 0.0;
+}
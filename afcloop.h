@@ -0,0 +1,43 @@
+#ifndef AFCLOOP_H
+#define AFCLOOP_H
+
+#define AFC_KP              0.3
+#define AFC_KI              0.02
+#define AFC_DEADBAND_HZ     3.0
+#define AFC_CAPTURE_HZ      250.0
+#define AFC_MAX_STEP_HZ     20.0
+#define AFC_MAX_CORR_HZ     2000.0
+#define AFC_VOLTAGE_MIN     0.0
+#define AFC_VOLTAGE_MAX     3.3
+#define AFC_SETTLE_MS       100     // tones measured sooner after a correction still see the old tuning
+
+/*
+ * How the measured RX tone moves when the VCO moves up by 1 Hz. With the VCO
+ * as a low side LO the tone is RF - LO, so it goes down.
+ */
+#define AFC_TONE_SENSE      (-1.0)
+
+/**
+ * @brief The AfcLoop class is a PI controller that holds the received mark
+ * or space tone on its nominal frequency. Its output is a VCO frequency
+ * offset which the caller turns into either a DAC voltage (through the VCO
+ * calibration slope) or a frequency setpoint.
+ */
+class AfcLoop
+{
+public:
+    AfcLoop();
+
+    void reset();
+    bool update(double toneHz, double markHz, double spaceHz);
+
+    double errorHz() const { return m_errorHz; }
+    double correctionHz() const { return m_correctionHz; }
+
+private:
+    double m_integral;
+    double m_errorHz;
+    double m_correctionHz;
+};
+
+#endif // AFCLOOP_H
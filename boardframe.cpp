@@ -0,0 +1,214 @@
+#include "boardframe.h"
+#include <cstring>
+
+struct CrcTable {
+    uint16_t entries[256];
+    CrcTable(){
+        for(int i = 0; i < 256; i++){
+            uint16_t crc = (uint16_t)(i << 8);
+            for(int bit = 0; bit < 8; bit++){
+                crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+/**
+ * @brief crc16Ccitt table driven CRC-16/CCITT-FALSE
+ * @param crc running value, pass the previous result to continue a CRC
+ */
+uint16_t crc16Ccitt(const uint8_t* data, int len, uint16_t crc){
+    static const CrcTable table;
+    for(int i = 0; i < len; i++){
+        crc = (uint16_t)((crc << 8) ^ table.entries[((crc >> 8) ^ data[i]) & 0xFF]);
+    }
+    return crc;
+}
+
+struct Crc32Table {
+    uint32_t entries[256];
+    Crc32Table(){
+        for(uint32_t i = 0; i < 256; i++){
+            uint32_t crc = i;
+            for(int bit = 0; bit < 8; bit++){
+                crc = (crc & 1) ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+            }
+            entries[i] = crc;
+        }
+    }
+};
+
+/**
+ * @brief crc32Ieee table driven CRC-32 (the zlib one), used to identify
+ * whole tables rather than to protect frames
+ * @param crc running value, pass the previous result to continue a CRC
+ */
+uint32_t crc32Ieee(const uint8_t* data, int len, uint32_t crc){
+    static const Crc32Table table;
+    crc = ~crc;
+    for(int i = 0; i < len; i++){
+        crc = (crc >> 8) ^ table.entries[(crc ^ data[i]) & 0xFF];
+    }
+    return ~crc;
+}
+
+/***************/
+/* BOARD FRAME */
+/***************/
+
+/**
+ * @brief BoardFrame::encode wire bytes of the frame
+ * @return empty if the payload doesn't fit in one frame
+ */
+QByteArray BoardFrame::encode() const{
+    if(payload.length() > FRAME_MAX_PAYLOAD){
+        return QByteArray();
+    }
+    int len = payload.length();
+    QByteArray buf(FRAME_HEADER_LEN + len + FRAME_CRC_LEN, 0x00);
+    uint8_t* raw = (uint8_t*)buf.data();
+    raw[0] = FRAME_SYNC_0;
+    raw[1] = FRAME_SYNC_1;
+    raw[2] = version;
+    raw[3] = seq;
+    raw[4] = cmd;
+    raw[5] = (uint8_t)len;
+    memcpy(raw + FRAME_HEADER_LEN, payload.constData(), len);
+
+    uint16_t crc = crc16Ccitt(raw + 2, FRAME_HEADER_LEN - 2 + len);
+    raw[FRAME_HEADER_LEN + len] = crc & 0xFF;
+    raw[FRAME_HEADER_LEN + len + 1] = crc >> 8;
+    return buf;
+}
+
+/*****************/
+/* FRAME DECODER */
+/*****************/
+
+FrameDecoder::FrameDecoder()
+{
+    m_pos = 0;
+    m_crcErrors = 0;
+    m_skippedBytes = 0;
+}
+
+void FrameDecoder::feed(const char* data, int len){
+    m_buf.append(data, len);
+}
+
+void FrameDecoder::clear(){
+    m_buf.clear();
+    m_pos = 0;
+}
+
+/**
+ * @brief FrameDecoder::next
+ * @param frame filled in with the next valid frame
+ * @return false if no complete valid frame is buffered yet
+ */
+bool FrameDecoder::next(BoardFrame* frame){
+    const uint8_t* raw = (const uint8_t*)m_buf.constData();
+    int end = m_buf.length();
+
+    while(end - m_pos >= FRAME_HEADER_LEN){
+        // hunt for the sync word
+        const void* hit = memchr(raw + m_pos, FRAME_SYNC_0, end - m_pos);
+        if(hit == nullptr){
+            m_skippedBytes += end - m_pos;
+            m_pos = end;
+            break;
+        }
+        int start = (int)((const uint8_t*)hit - raw);
+        m_skippedBytes += start - m_pos;
+        m_pos = start;
+        if(end - m_pos < FRAME_HEADER_LEN){
+            break;
+        }
+        if(raw[m_pos + 1] != FRAME_SYNC_1 || raw[m_pos + 2] != FRAME_VERSION){
+            m_pos++;
+            m_skippedBytes++;
+            continue;
+        }
+
+        int len = raw[m_pos + 5];
+        int total = FRAME_HEADER_LEN + len + FRAME_CRC_LEN;
+        if(end - m_pos < total){
+            // wait for the rest of the frame, unless a whole frame already
+            // sits inside the span this length claims
+            int later = -1;
+            for(int i = m_pos + 1; i + FRAME_HEADER_LEN + FRAME_CRC_LEN <= end; i++){
+                if(validAt(i)){
+                    later = i;
+                    break;
+                }
+            }
+            if(later < 0){
+                break;
+            }
+            m_crcErrors++;
+            m_skippedBytes += later - m_pos;
+            m_pos = later;
+            continue;
+        }
+
+        if(!validAt(m_pos)){
+            // not a frame after all, resync from the next byte
+            m_crcErrors++;
+            m_pos++;
+            m_skippedBytes++;
+            continue;
+        }
+
+        frame->version = raw[m_pos + 2];
+        frame->seq = raw[m_pos + 3];
+        frame->cmd = raw[m_pos + 4];
+        frame->payload = QByteArray((const char*)raw + m_pos + FRAME_HEADER_LEN, len);
+        m_pos += total;
+        compact();
+        return true;
+    }
+
+    compact();
+    return false;
+}
+
+/**
+ * @brief FrameDecoder::dropPending give up on a buffered header that is
+ * still waiting for its tail and rescan from the byte after its sync word.
+ * For when the reply it would hold back has timed out.
+ */
+void FrameDecoder::dropPending(){
+    if(m_pos < m_buf.length() && (uint8_t)m_buf[m_pos] == FRAME_SYNC_0){
+        m_pos++;
+        m_skippedBytes++;
+        compact();
+    }
+}
+
+/**
+ * @brief FrameDecoder::validAt a complete frame with a good CRC starts at pos
+ */
+bool FrameDecoder::validAt(int pos) const{
+    const uint8_t* raw = (const uint8_t*)m_buf.constData();
+    int end = m_buf.length();
+    if(end - pos < FRAME_HEADER_LEN + FRAME_CRC_LEN || raw[pos] != FRAME_SYNC_0
+            || raw[pos + 1] != FRAME_SYNC_1 || raw[pos + 2] != FRAME_VERSION){
+        return false;
+    }
+    int len = raw[pos + 5];
+    int total = FRAME_HEADER_LEN + len + FRAME_CRC_LEN;
+    if(end - pos < total){
+        return false;
+    }
+    uint16_t crc = crc16Ccitt(raw + pos + 2, FRAME_HEADER_LEN - 2 + len);
+    uint16_t rxCrc = (uint16_t)(raw[pos + total - 2] | (raw[pos + total - 1] << 8));
+    return crc == rxCrc;
+}
+
+void FrameDecoder::compact(){
+    if(m_pos > 0){
+        m_buf.remove(0, m_pos);
+        m_pos = 0;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef BOARDFRAME_H
+#define BOARDFRAME_H
+
+#include <QByteArray>
+#include <inttypes.h>
+
+/*
+ * Framed board link, version 1
+ *
+ *  +------+------+-----+-----+-----+-----+-------------+--------+
+ *  | 0xA5 | 0x5A | ver | seq | cmd | len | payload     | crc16  |
+ *  +------+------+-----+-----+-----+-----+-------------+--------+
+ *
+ * crc16 is CRC-16/CCITT-FALSE (poly 0x1021, init 0xFFFF) over ver..payload,
+ * sent little endian. Replies echo the seq of the request they answer.
+ */
+#define FRAME_SYNC_0        0xA5
+#define FRAME_SYNC_1        0x5A
+#define FRAME_VERSION       1
+#define FRAME_HEADER_LEN    6
+#define FRAME_CRC_LEN       2
+#define FRAME_MAX_PAYLOAD   255
+
+uint16_t crc16Ccitt(const uint8_t* data, int len, uint16_t crc = 0xFFFF);
+uint32_t crc32Ieee(const uint8_t* data, int len, uint32_t crc = 0);
+
+struct BoardFrame {
+    uint8_t version = FRAME_VERSION;
+    uint8_t seq = 0;
+    uint8_t cmd = 0;
+    QByteArray payload;
+
+    QByteArray encode() const;
+};
+
+/**
+ * @brief The FrameDecoder class pulls valid frames out of a raw byte stream.
+ * Garbage, truncated frames and CRC failures are skipped by sliding forward
+ * to the next sync word, so the decoder is back in step within one frame of
+ * a corrupted or dropped byte and every input byte is scanned a bounded
+ * number of times. The length byte isn't covered until the CRC arrives, so
+ * a header still waiting for its tail is given up as soon as a complete
+ * valid frame shows up behind it, rather than holding back the replies that
+ * follow a corrupted length.
+ */
+class FrameDecoder
+{
+public:
+    FrameDecoder();
+
+    void feed(const char* data, int len);
+    void feed(const QByteArray& data) { feed(data.constData(), data.length()); }
+    bool next(BoardFrame* frame);
+    void clear();
+    void dropPending();
+
+    quint64 crcErrors() const { return m_crcErrors; }
+    quint64 skippedBytes() const { return m_skippedBytes; }
+
+private:
+    void compact();
+    bool validAt(int pos) const;
+
+    QByteArray m_buf;
+    int m_pos;
+    quint64 m_crcErrors;
+    quint64 m_skippedBytes;
+};
+
+#endif // BOARDFRAME_H
@@ -0,0 +1,435 @@
+#include "boardmanager.h"
+#include <cstring>
+
+BoardManager::BoardManager(QObject *parent)
+    : QObject{parent}
+{
+    m_nextId = 0;
+    m_rr = 0;
+    m_schema = RttyBoard::builtinSchema();
+    m_pollFields = m_schema.ids();
+
+    m_roundTripHist = Instrumentation::instance().histogram("manager.roundTrip");
+    m_passHist = Instrumentation::instance().histogram("manager.servicePass");
+    m_timeouts = Instrumentation::instance().counter("manager.timeouts");
+    m_staleFrames = Instrumentation::instance().counter("manager.staleFrames");
+    m_crcErrors = Instrumentation::instance().counter("manager.crcErrors");
+
+    // the worker object, its timer and every station's port live on m_thread
+    m_thread = new QThread(this);
+    m_worker = new QObject();
+    m_worker->moveToThread(m_thread);
+    m_timer = new QTimer();
+    m_timer->setSingleShot(true);
+    m_timer->moveToThread(m_thread);
+    connect(m_timer, &QTimer::timeout, m_worker, [this](){ service(); });
+    m_clock = Clock::system();
+    m_thread->start();
+}
+
+BoardManager::~BoardManager(){
+    stop();
+}
+
+/**
+ * @brief BoardManager::addBoard start driving the board on comport. Returns
+ * straight away; progress comes through stationStatus().
+ * @return the station id used by every other call
+ */
+int BoardManager::addBoard(QString comport, int pollIntervalMs){
+    Station* st = new Station();
+    st->comport = comport;
+    st->pollIntervalMs = qMax(1, pollIntervalMs);
+    memset(&st->state, 0, sizeof(st->state));
+
+    QMutexLocker lock(&m_stationsMtx);
+    st->id = m_nextId++;
+    m_stations.insert(st->id, st);
+    lock.unlock();
+
+    post([this](){ service(); });
+    return st->id;
+}
+
+/**
+ * @brief BoardManager::removeBoard stop driving station id. Blocks until its
+ * port is closed, so the caller can open the port itself straight after.
+ */
+void BoardManager::removeBoard(int id){
+    if(!m_thread->isRunning()){
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, [this, id](){
+        QMutexLocker lock(&m_stationsMtx);
+        Station* st = m_stations.take(id);
+        lock.unlock();
+        if(st != nullptr){
+            closePort(st, false);
+            setLink(st, LinkState::DISCONNECTED, QString("%1 removed").arg(st->comport));
+            delete st;
+        }
+    }, Qt::BlockingQueuedConnection);
+}
+
+void BoardManager::setPollInterval(int id, int pollIntervalMs){
+    post([this, id, pollIntervalMs](){
+        Station* st = station(id);
+        if(st != nullptr){
+            st->pollIntervalMs = qMax(1, pollIntervalMs);
+            st->nextPollMs = m_clock->nowMs();
+            service();
+        }
+    });
+}
+
+void BoardManager::setFields(int id, QList<QPair<uint8_t, uint32_t>> fields){
+    post([this, id, fields](){
+        Station* st = station(id);
+        if(st != nullptr && st->link == LinkState::CONNECTED){
+            enqueue(st, Purpose::SET, CMD_SET_FIELDS, RttyBoard::encodeFieldValues(fields));
+            service();
+        }
+    });
+}
+
+void BoardManager::setMode(int id, RttyBoard::Mode mode){
+    setFields(id, {{m_schema.field("mode")->id, (uint32_t)mode}});
+}
+
+/**
+ * @brief BoardManager::stateSnapshot latest polled state of station id
+ * @return the snapshot's version, 0 if the station doesn't exist or hasn't
+ * been polled yet
+ */
+quint64 BoardManager::stateSnapshot(int id, RttyState* state) const{
+    QMutexLocker lock(&m_stationsMtx);
+    Station* st = m_stations.value(id, nullptr);
+    return st == nullptr ? 0 : st->publisher.read(state);
+}
+
+QList<int> BoardManager::stations() const{
+    QMutexLocker lock(&m_stationsMtx);
+    return m_stations.keys();
+}
+
+/**
+ * @brief BoardManager::stop close every station and stop the thread
+ */
+void BoardManager::stop(){
+    if(!m_thread->isRunning()){
+        return;
+    }
+    QMetaObject::invokeMethod(m_worker, [this](){
+        m_timer->stop();
+        QMutexLocker lock(&m_stationsMtx);
+        for(auto st : m_stations){
+            closePort(st, false);
+            setLink(st, LinkState::DISCONNECTED, QString("%1 closed").arg(st->comport));
+            delete st;
+        }
+        m_stations.clear();
+        lock.unlock();
+        delete m_timer;
+        m_timer = nullptr;
+    }, Qt::BlockingQueuedConnection);
+    m_thread->quit();
+    m_thread->wait();
+    delete m_worker;
+    m_worker = nullptr;
+}
+
+/*******************/
+/* PRIVATE METHODS */
+/*******************/
+
+/**
+ * @brief BoardManager::station look up a station from the worker thread.
+ * Only the worker removes stations, so the pointer stays good after the
+ * lock is dropped.
+ */
+BoardManager::Station* BoardManager::station(int id){
+    QMutexLocker lock(&m_stationsMtx);
+    return m_stations.value(id, nullptr);
+}
+
+void BoardManager::post(std::function<void()> fn){
+    if(m_worker != nullptr){
+        QMetaObject::invokeMethod(m_worker, fn, Qt::QueuedConnection);
+    }
+}
+
+/**
+ * @brief BoardManager::service one pass over every station: reopen ports
+ * that are due, expire replies, queue polls and put at most one request per
+ * station on the wire. Then arm the timer for the next deadline.
+ */
+void BoardManager::service(){
+    if(m_timer == nullptr){
+        return; // stop() has torn down, a late queued call has nothing to do
+    }
+    LatencyTimer timer(m_passHist);
+    qint64 now = m_clock->nowMs();
+
+    // only this thread removes stations, so the pointers outlive the lock
+    m_stationsMtx.lock();
+    QList<Station*> stations = m_stations.values();
+    m_stationsMtx.unlock();
+    if(stations.isEmpty()){
+        return;
+    }
+
+    qint64 wake = now + RECONNECT_MAX_MS;
+    int n = stations.length();
+    m_rr = (m_rr + 1) % n;
+    for(int k = 0; k < n; k++){
+        Station* st = stations[(m_rr + k) % n];
+
+        if(st->port == nullptr){
+            if(now >= st->reopenAtMs){
+                openStation(st);
+            }
+            if(st->port == nullptr){
+                wake = qMin(wake, st->reopenAtMs);
+                continue;
+            }
+        }
+
+        if(st->busy && now >= st->deadlineMs){
+            timedOut(st);
+            if(st->port == nullptr){
+                wake = qMin(wake, st->reopenAtMs);
+                continue;
+            }
+        }
+
+        if(st->link == LinkState::CONNECTED && now >= st->nextPollMs){
+            if(!st->pollQueued){
+                QByteArray ids(m_pollFields.length(), 0x00);
+                for(int i = 0; i < m_pollFields.length(); i++){
+                    ids[i] = m_pollFields[i];
+                }
+                enqueue(st, Purpose::POLL, CMD_READ_FIELDS, ids);
+                st->pollQueued = true;
+            }
+            // a station that fell behind skips the polls it missed
+            st->nextPollMs = qMax(st->nextPollMs + st->pollIntervalMs, now + 1);
+        }
+
+        if(!st->busy && !st->queue.isEmpty()){
+            send(st);
+        }
+
+        if(st->busy){
+            wake = qMin(wake, st->deadlineMs);
+        }else if(!st->queue.isEmpty()){
+            wake = now; // unanswered writes still queued behind this one
+        }
+        if(st->link == LinkState::CONNECTED){
+            wake = qMin(wake, st->nextPollMs);
+        }
+    }
+
+    m_timer->start((int)qMax((qint64)0, wake - m_clock->nowMs()));
+}
+
+void BoardManager::openStation(Station* st){
+    st->port = new QSerialPort(st->comport);
+    st->port->setBaudRate(BOARD_DEFAULT_LINK_RATE);
+    setLink(st, LinkState::CONNECTING, QString("Opening %1").arg(st->comport));
+    if(!st->port->open(QIODeviceBase::ReadWrite)){
+        closeStation(st, QString("%1 won't open").arg(st->comport));
+        return;
+    }
+    st->port->clear();
+    connect(st->port, &QSerialPort::readyRead, m_worker, [this, st](){ onReadyRead(st); });
+    connect(st->port, &QSerialPort::errorOccurred, m_worker, [this, st](QSerialPort::SerialPortError error){
+        if(error == QSerialPort::ResourceError){
+            closeStation(st, QString("%1 lost").arg(st->comport));
+        }
+    });
+
+    st->protocol = RttyBoard::LinkProtocol::LEGACY;
+    st->decoder.clear();
+    st->legacyBuf.clear();
+    st->queue.clear();
+    st->busy = false;
+    st->pollQueued = false;
+    st->timeouts = 0;
+    enqueue(st, Purpose::OFFER, CMD_TEST_COMMS, QByteArray(1, (char)FRAME_VERSION));
+}
+
+/**
+ * @brief BoardManager::closeStation drop the port and schedule a reopen with
+ * backoff
+ */
+void BoardManager::closeStation(Station* st, QString detail){
+    closePort(st, true);
+    int delay = st->backoff.nextDelayMs();
+    st->reopenAtMs = m_clock->nowMs() + delay;
+    setLink(st, LinkState::RETRYING, QString("%1, retry %2 in %3 ms").arg(detail).arg(st->backoff.attempts()).arg(delay));
+}
+
+/**
+ * @brief BoardManager::closePort close and free the station's port
+ * @param later defer the delete, for when we may be inside one of the port's
+ * own signals
+ */
+void BoardManager::closePort(Station* st, bool later){
+    if(st->port != nullptr){
+        st->port->disconnect(m_worker);
+        st->port->close();
+        if(later){
+            st->port->deleteLater();
+        }else{
+            delete st->port;
+        }
+        st->port = nullptr;
+    }
+    st->busy = false;
+    st->queue.clear();
+    st->pollQueued = false;
+}
+
+void BoardManager::enqueue(Station* st, Purpose purpose, uint8_t cmd, const QByteArray& payload){
+    if(st->queue.length() >= STATION_QUEUE_MAX || payload.length() > FRAME_MAX_PAYLOAD){
+        return;
+    }
+    st->queue.append({purpose, cmd, payload});
+}
+
+void BoardManager::send(Station* st){
+    Request req = st->queue.takeFirst();
+    uint8_t seq = 0;
+    if(st->protocol == RttyBoard::LinkProtocol::FRAMED){
+        seq = ++st->seq;
+    }
+    st->port->write(RttyBoard::encodeRequest(st->protocol, seq, req.cmd, req.payload));
+    if(req.purpose == Purpose::SET){
+        return; // the board doesn't answer CMD_SET_FIELDS
+    }
+    st->busy = true;
+    st->inFlight = req;
+    st->seq = seq;
+    st->sentNs = Clock::system()->nowNs();
+    st->deadlineMs = m_clock->nowMs() + STATION_RPY_TIMEOUT_MS;
+}
+
+/**
+ * @brief BoardManager::onReadyRead match whatever arrived against the one
+ * request in flight. Anything else is stale and dropped.
+ */
+void BoardManager::onReadyRead(Station* st){
+    QByteArray data = st->port->readAll();
+
+    if(st->protocol == RttyBoard::LinkProtocol::FRAMED){
+        quint64 crcErrors = st->decoder.crcErrors();
+        st->decoder.feed(data);
+        BoardFrame frame;
+        while(st->decoder.next(&frame)){
+            if(st->busy && frame.seq == st->seq && frame.cmd == st->inFlight.cmd){
+                complete(st, frame.payload);
+            }else{
+                m_staleFrames->add();
+            }
+        }
+        m_crcErrors->add(st->decoder.crcErrors() - crcErrors);
+    }else{
+        st->legacyBuf.append(data);
+        while(st->legacyBuf.length() >= 2){
+            int len = (uint8_t)st->legacyBuf[1];
+            if(st->legacyBuf.length() < 2 + len){
+                break;
+            }
+            uint8_t cmd = (uint8_t)st->legacyBuf[0];
+            QByteArray payload = st->legacyBuf.mid(2, len);
+            st->legacyBuf.remove(0, 2 + len);
+            if(st->busy && cmd == st->inFlight.cmd){
+                complete(st, payload);
+            }else{
+                m_staleFrames->add();
+            }
+        }
+    }
+
+    // the next request goes out on the following service pass, in turn
+    if(!st->busy && m_timer != nullptr){
+        m_timer->start(0);
+    }
+}
+
+void BoardManager::complete(Station* st, const QByteArray& reply){
+    m_roundTripHist->record(Clock::system()->nowNs() - st->sentNs);
+    st->busy = false;
+    st->timeouts = 0;
+
+    switch(st->inFlight.purpose){
+    case Purpose::OFFER:{
+        if(reply.length() >= 1 && (uint8_t)reply[0] == FRAME_VERSION){
+            st->protocol = RttyBoard::LinkProtocol::FRAMED;
+            st->decoder.clear();
+            enqueue(st, Purpose::CONFIRM, CMD_TEST_COMMS, QByteArray());
+        }else{
+            setLink(st, LinkState::CONNECTED, QString("%1 connected (legacy link)").arg(st->comport));
+        }
+        break;
+    }case Purpose::CONFIRM:{
+        bool framed = st->protocol == RttyBoard::LinkProtocol::FRAMED;
+        setLink(st, LinkState::CONNECTED, QString("%1 connected (%2 link)").arg(st->comport, framed ? "framed" : "legacy"));
+        break;
+    }case Purpose::POLL:{
+        st->pollQueued = false;
+        RttyBoard::applyFields(m_schema, RttyBoard::decodeFieldValues(reply), &st->state);
+        st->publisher.publish(st->state);
+        emit rxTone(st->id, st->state.rxTone);
+        if(st->state.rxDataRdy){
+            emit rxData(st->id, (uint8_t)st->state.rxData);
+        }
+        break;
+    }case Purpose::SET:{
+        break;
+    }
+    }
+}
+
+void BoardManager::timedOut(Station* st){
+    m_timeouts->add();
+    st->decoder.dropPending();
+    st->busy = false;
+    st->timeouts++;
+
+    switch(st->inFlight.purpose){
+    case Purpose::OFFER:{
+        closeStation(st, QString("%1 not responding").arg(st->comport));
+        return;
+    }case Purpose::CONFIRM:{
+        if(st->protocol == RttyBoard::LinkProtocol::FRAMED){
+            // board never switched over; it falls back to legacy by itself
+            st->protocol = RttyBoard::LinkProtocol::LEGACY;
+            st->legacyBuf.clear();
+            st->port->clear();
+            enqueue(st, Purpose::CONFIRM, CMD_TEST_COMMS, QByteArray());
+        }else{
+            closeStation(st, QString("%1 not responding").arg(st->comport));
+        }
+        return;
+    }case Purpose::POLL:{
+        st->pollQueued = false;
+        break;
+    }case Purpose::SET:{
+        break;
+    }
+    }
+
+    if(st->timeouts >= STATION_MAX_TIMEOUTS){
+        closeStation(st, QString("%1 stopped answering").arg(st->comport));
+    }
+}
+
+void BoardManager::setLink(Station* st, LinkState state, QString detail){
+    st->link = state;
+    if(state == LinkState::CONNECTED){
+        st->backoff.reset();
+        st->nextPollMs = m_clock->nowMs();
+    }
+    emit stationStatus(st->id, st->comport, state, detail);
+}
@@ -0,0 +1,129 @@
+#ifndef BOARDMANAGER_H
+#define BOARDMANAGER_H
+
+#include <QObject>
+#include <QMap>
+#include <QMutex>
+#include <QSerialPort>
+#include <QThread>
+#include <QTimer>
+#include <functional>
+
+#include "rttyboard.h"
+#include "boardframe.h"
+#include "fieldschema.h"
+#include "reconnect.h"
+#include "statepublisher.h"
+#include "instrumentation.h"
+#include "clock.h"
+
+#define STATION_POLL_DEFAULT_MS     20
+#define STATION_RPY_TIMEOUT_MS      BOARD_RPY_TIMEOUT_MS
+#define STATION_MAX_TIMEOUTS        3
+#define STATION_QUEUE_MAX           64
+
+/**
+ * @brief The BoardManager class drives many boards from one event loop
+ * thread instead of one spinning Rtty thread each. Every board (station) is
+ * a small state machine on a non-blocking QSerialPort: it negotiates the
+ * link protocol, polls its fields on its own schedule and reconnects with
+ * backoff, all from readyRead and a single timer armed for the earliest
+ * deadline of any station. A service pass walks the stations round robin
+ * from a rotating start and lets each put at most one transaction on the
+ * wire, so a chatty board can't starve the others.
+ *
+ * Each station's latest state is published through a StatePublisher and is
+ * read with stateSnapshot() from any thread; RX bytes and tones come out as
+ * per-station signals. All public methods are thread safe.
+ */
+class BoardManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit BoardManager(QObject *parent = nullptr);
+    ~BoardManager();
+
+    int addBoard(QString comport, int pollIntervalMs = STATION_POLL_DEFAULT_MS);
+    void removeBoard(int id);
+    void setPollInterval(int id, int pollIntervalMs);
+    void setFields(int id, QList<QPair<uint8_t, uint32_t>> fields);
+    void setMode(int id, RttyBoard::Mode mode);
+    quint64 stateSnapshot(int id, RttyState* state) const;
+    QList<int> stations() const;
+    void stop();
+
+signals:
+    void stationStatus(int id, QString comport, LinkState state, QString detail);
+    void rxData(int id, uint8_t data);
+    void rxTone(int id, float tone);
+
+private:
+    enum class Purpose : int {
+        OFFER,      // legacy CMD_TEST_COMMS offering the framed protocol
+        CONFIRM,    // CMD_TEST_COMMS in the protocol we settled on
+        POLL,       // CMD_READ_FIELDS for the state
+        SET         // CMD_SET_FIELDS, never answered
+    };
+
+    struct Request {
+        Purpose purpose;
+        uint8_t cmd;
+        QByteArray payload;
+    };
+
+    struct Station {
+        int id;
+        QString comport;
+        QSerialPort* port = nullptr;
+        LinkState link = LinkState::DISCONNECTED;
+        RttyBoard::LinkProtocol protocol = RttyBoard::LinkProtocol::LEGACY;
+        FrameDecoder decoder;
+        QByteArray legacyBuf;
+        ReconnectBackoff backoff;
+        qint64 reopenAtMs = 0;
+        int pollIntervalMs = STATION_POLL_DEFAULT_MS;
+        qint64 nextPollMs = 0;
+        bool pollQueued = false;
+        QList<Request> queue;
+        bool busy = false;
+        Request inFlight;
+        uint8_t seq = 0;
+        qint64 sentNs = 0;
+        qint64 deadlineMs = 0;
+        int timeouts = 0;
+        RttyState state;
+        StatePublisher<RttyState> publisher;
+    };
+
+    Station* station(int id);
+    void post(std::function<void()> fn);
+    void service();
+    void openStation(Station* st);
+    void closeStation(Station* st, QString detail);
+    void closePort(Station* st, bool later);
+    void send(Station* st);
+    void onReadyRead(Station* st);
+    void complete(Station* st, const QByteArray& reply);
+    void timedOut(Station* st);
+    void setLink(Station* st, LinkState state, QString detail);
+    void enqueue(Station* st, Purpose purpose, uint8_t cmd, const QByteArray& payload);
+
+    QThread* m_thread;
+    QObject* m_worker;
+    QTimer* m_timer;
+    Clock* m_clock;
+    mutable QMutex m_stationsMtx;
+    QMap<int, Station*> m_stations;
+    int m_nextId;
+    int m_rr;
+    FieldSchema m_schema;
+    QList<uint8_t> m_pollFields;
+
+    LatencyHistogram* m_roundTripHist;
+    LatencyHistogram* m_passHist;
+    EventCounter* m_timeouts;
+    EventCounter* m_staleFrames;
+    EventCounter* m_crcErrors;
+};
+
+#endif // BOARDMANAGER_H
@@ -0,0 +1,87 @@
+#include "calibrationengine.h"
+
+CalibrationEngine::CalibrationEngine(SpectrumAnalyzer* analyzer, Clock* clock)
+{
+    m_analyzer = analyzer;
+    m_clock = clock;
+    m_state = CalibrationEngine::State::IDLE;
+    m_vcoSetpt = 0.0;
+    m_sweeps = 0;
+}
+
+void CalibrationEngine::start(){
+    m_state = CalibrationEngine::State::START_CALIBRATION;
+}
+
+void CalibrationEngine::stop(){
+    if(m_state != CalibrationEngine::State::IDLE){
+        m_state = CalibrationEngine::State::STOP_CALIBRATION;
+    }
+}
+
+/**
+ * @brief CalibrationEngine::step run one pass of the state machine. A pass
+ * in CALIBRATION measures one VCO point.
+ */
+void CalibrationEngine::step(){
+    switch(m_state){
+    case CalibrationEngine::State::IDLE:{
+        break;
+    }case CalibrationEngine::State::START_CALIBRATION:{
+        m_analyzer->setRBW(100000.0);
+        m_analyzer->setStartFreq(10.0e6);
+        m_analyzer->setStopFreq(40.0e6);
+        m_analyzer->setRefLevel(10); // 10 dBm
+        m_analyzer->setContPeak(true);
+        m_clock->sleepUs(CAL_SETUP_SETTLE_US);
+        m_analyzer->setMarkerAsCenter(); // peak becomes center of the spectrum
+        m_analyzer->setFreqSpan(CAL_SEARCH_SPAN_HZ);
+        m_analyzer->setRBW(300.0);
+
+        m_state = CalibrationEngine::State::CALIBRATION;
+        m_vcoSetpt = 0.0;
+        m_sweeps = 0;
+        break;
+    }case CalibrationEngine::State::CALIBRATION:{
+        if(onSetVcoVoltage){
+            onSetVcoVoltage(m_vcoSetpt);
+        }
+        m_clock->sleepUs(CAL_VCO_SETTLE_US); // allow things to settle
+        m_analyzer->setMarkerAsCenter(); // center the peak on the screen
+        // The wide span only finds the peak, its trace points are too far
+        // apart for the marker to resolve the tolerance. Measure on a narrow
+        // span around it, then open up again for the next step.
+        m_analyzer->setFreqSpan(CAL_POINT_SPAN_HZ);
+        m_estimator.setResolution(m_analyzer->getMarkerResolution());
+        m_clock->sleepUs(CAL_CENTER_SETTLE_US);
+
+        // one marker reading per sweep until the estimate is tight enough
+        qint64 sweepTime = (qint64)(m_analyzer->getSweepTime()*1.0e6);
+        m_clock->sleepUs(sweepTime + CAL_SWEEP_MARGIN_US); // first full sweep on the narrow span
+        m_estimator.reset();
+        while(!m_estimator.addSample(m_analyzer->getMarkerFreq())){
+            m_clock->sleepUs(sweepTime + CAL_SWEEP_MARGIN_US);
+        }
+        m_sweeps += m_estimator.total();
+        m_analyzer->setFreqSpan(CAL_SEARCH_SPAN_HZ);
+        if(onPointComplete){
+            onPointComplete(m_vcoSetpt, m_estimator.mean());
+        }
+        if(onPointStats){
+            onPointStats(m_estimator.mean(), m_estimator.halfWidth(), m_estimator.count(), m_estimator.rejected());
+        }
+
+        m_vcoSetpt += VCO_VOLTAGE_STEP;
+        if(m_vcoSetpt > VCO_VOLTAGE_MAX + VCO_VOLTAGE_STEP/2.0){
+            m_state = CalibrationEngine::State::STOP_CALIBRATION;
+        }
+        break;
+    }case CalibrationEngine::State::STOP_CALIBRATION:{
+        if(onComplete){
+            onComplete();
+        }
+        m_state = CalibrationEngine::State::IDLE;
+        break;
+    }
+    };
+}
@@ -0,0 +1,61 @@
+#ifndef CALIBRATIONENGINE_H
+#define CALIBRATIONENGINE_H
+
+#include <functional>
+
+#include "clock.h"
+#include "spectrumanalyzer.h"
+#include "measurementestimator.h"
+
+#define VCO_STEPS           512
+#define VCO_VOLTAGE_MAX     3.3
+#define VCO_VOLTAGE_STEP    (VCO_VOLTAGE_MAX/(VCO_STEPS - 1))
+
+#define CAL_SETUP_SETTLE_US     100000
+#define CAL_VCO_SETTLE_US       250000
+#define CAL_CENTER_SETTLE_US    50000
+#define CAL_SWEEP_MARGIN_US     1000
+#define CAL_SEARCH_SPAN_HZ      500000.0    // finds the peak after a VCO step
+#define CAL_POINT_SPAN_HZ       5000.0      // measures it, 6.7 Hz per trace point
+
+/**
+ * @brief The CalibrationEngine class is the VCO calibration state machine:
+ * set up the analyzer around the VCO peak, then step the VCO voltage across
+ * its range and measure the frequency at each step. All waiting goes through
+ * the injected Clock and all instrument access through SpectrumAnalyzer.
+ */
+class CalibrationEngine
+{
+public:
+    enum class State : int {
+        IDLE,
+        START_CALIBRATION,
+        CALIBRATION,
+        STOP_CALIBRATION
+    };
+
+    CalibrationEngine(SpectrumAnalyzer* analyzer, Clock* clock);
+
+    std::function<void(double)> onSetVcoVoltage;
+    std::function<void(double, double)> onPointComplete;   // voltage, frequency
+    std::function<void(double, double, int, int)> onPointStats;
+    std::function<void()> onComplete;
+
+    void start();
+    void stop();
+    void step();
+
+    CalibrationEngine::State state() const { return m_state; }
+    MeasurementEstimator& estimator() { return m_estimator; }
+    int sweeps() const { return m_sweeps; }
+
+private:
+    SpectrumAnalyzer* m_analyzer;
+    Clock* m_clock;
+    CalibrationEngine::State m_state;
+    MeasurementEstimator m_estimator;
+    double m_vcoSetpt;
+    int m_sweeps;
+};
+
+#endif // CALIBRATIONENGINE_H
@@ -0,0 +1,62 @@
+#include <QCoreApplication>
+#include <QTextStream>
+
+#include "calsimulation.h"
+#include "calibrationengine.h"
+
+/*
+ * Runs the VCO calibration flow against simulated instruments in virtual
+ * time and compares sampling strategies.
+ *
+ *   RTTY_CalSim [noiseHz] [toleranceHz]
+ */
+
+struct Strategy {
+    QString name;
+    int minSamples;
+    int maxSamples;
+    double toleranceHz;
+    bool rejectOutliers;
+};
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+
+    SimConfig cfg;
+    if(args.length() > 1){
+        cfg.noiseHz = args[1].toDouble();
+    }
+    if(args.length() > 2){
+        cfg.toleranceHz = args[2].toDouble();
+    }
+
+    QList<Strategy> strategies = {
+        // the old flow: a plain mean of ten sweeps, spurs and all
+        {"fixed-10", 10, 10, 0.0, false},
+        {"sequential", 2, 30, cfg.toleranceHz, true},
+        {"sequential-loose", 2, 30, cfg.toleranceHz*3.0, true},
+    };
+
+    QTextStream out(stdout);
+    out << QString("noise %1 Hz, %2 points per run\n").arg(cfg.noiseHz).arg(VCO_STEPS);
+    out << "strategy           points  sweeps  sim time (s)  cpu time (ms)  rms err (Hz)  max err (Hz)\n";
+    for(const auto& strategy : strategies){
+        SimConfig run = cfg;
+        run.minSamples = strategy.minSamples;
+        run.maxSamples = strategy.maxSamples;
+        run.toleranceHz = strategy.toleranceHz;
+        run.rejectOutliers = strategy.rejectOutliers;
+        SimResult r = runSimulatedCalibration(run);
+        out << QString("%1 %2 %3 %4 %5 %6 %7\n")
+                   .arg(strategy.name, -18)
+                   .arg(r.points, 6)
+                   .arg(r.sweeps, 7)
+                   .arg(r.simTimeUs/1.0e6, 13, 'f', 1)
+                   .arg(r.cpuTimeUs/1000.0, 14, 'f', 2)
+                   .arg(r.rmsErrorHz, 13, 'f', 2)
+                   .arg(r.maxErrorHz, 13, 'f', 2);
+    }
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "calsimulation.h"
+#include "calibrationengine.h"
+
+#include <QtMath>
+#include <ctime>
+
+/***********/
+/* SIM VCO */
+/***********/
+
+SimVco::SimVco(const SimConfig& cfg, Clock* clock)
+    : m_cfg(cfg)
+{
+    m_clock = clock;
+    m_fromHz = freqAt(0.0);
+    m_toHz = m_fromHz;
+    m_changedUs = 0;
+}
+
+void SimVco::setVoltage(double voltage){
+    m_fromHz = freqNow();
+    m_toHz = freqAt(voltage);
+    m_changedUs = m_clock->nowUs();
+}
+
+double SimVco::freqNow(){
+    double t = (double)(m_clock->nowUs() - m_changedUs);
+    return m_toHz + (m_fromHz - m_toHz)*qExp(-t/m_cfg.settleTauUs);
+}
+
+double SimVco::freqAt(double voltage) const{
+    return m_cfg.f0Hz + m_cfg.k1HzPerV*voltage + m_cfg.k2HzPerV2*voltage*voltage;
+}
+
+/****************/
+/* SIM ANALYZER */
+/****************/
+
+SimAnalyzer::SimAnalyzer(const SimConfig& cfg, Clock* clock, SimVco* vco)
+    : m_cfg(cfg), m_rng(cfg.seed)
+{
+    m_clock = clock;
+    m_vco = vco;
+    m_startHz = 0.0;
+    m_spanHz = CAL_SEARCH_SPAN_HZ;
+}
+
+double SimAnalyzer::getMarkerFreq(){
+    command();
+    // Box-Muller
+    double u1 = qMax(m_rng.generateDouble(), 1.0e-12);
+    double u2 = m_rng.generateDouble();
+    double gauss = qSqrt(-2.0*qLn(u1))*qCos(2.0*M_PI*u2);
+    double freq = m_vco->freqNow() + gauss*m_cfg.noiseHz;
+    if(m_rng.generateDouble() < m_cfg.outlierProb){
+        freq += (m_rng.generateDouble() < 0.5 ? -1.0 : 1.0)*m_cfg.outlierHz;
+    }
+    double resolution = m_spanHz/(m_cfg.tracePoints - 1);
+    return qRound64(freq/resolution)*resolution;
+}
+
+double SimAnalyzer::getSweepTime(){
+    command();
+    return m_cfg.sweepTimeS;
+}
+
+double SimAnalyzer::getMarkerResolution(){
+    command();
+    return m_spanHz/(m_cfg.tracePoints - 1);
+}
+
+void SimAnalyzer::setRefLevel(int ref){ Q_UNUSED(ref); command(); }
+void SimAnalyzer::setStartFreq(double start){ m_startHz = start; command(); }
+void SimAnalyzer::setStopFreq(double stop){ m_spanHz = stop - m_startHz; command(); }
+void SimAnalyzer::setFreqSpan(double span){ m_spanHz = span; command(); }
+void SimAnalyzer::setRBW(double rbw){ Q_UNUSED(rbw); command(); }
+void SimAnalyzer::setContPeak(bool on_off){ Q_UNUSED(on_off); command(); }
+void SimAnalyzer::setMarkerAsCenter(){ command(); }
+
+void SimAnalyzer::command(){
+    m_clock->sleepUs((qint64)m_cfg.commandLatencyUs);
+}
+
+/**************/
+/* SIMULATION */
+/**************/
+
+/**
+ * @brief processCpuUs CPU time used by this process so far, all threads
+ */
+static qint64 processCpuUs(){
+#ifdef Q_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+    return (qint64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+#else
+    return (qint64)std::clock()*1000000/CLOCKS_PER_SEC;
+#endif
+}
+
+/**
+ * @brief runSimulatedCalibration run the real CalibrationEngine end to end
+ * against the models on a virtual clock
+ * @return simulated instrument time, host CPU time and accuracy of the
+ * measured curve against the model's true tuning curve
+ */
+SimResult runSimulatedCalibration(const SimConfig& cfg){
+    qint64 cpuStartUs = processCpuUs();
+
+    VirtualClock clock;
+    SimVco vco(cfg, &clock);
+    SimAnalyzer analyzer(cfg, &clock, &vco);
+    CalibrationEngine engine(&analyzer, &clock);
+    engine.estimator() = MeasurementEstimator(cfg.toleranceHz, cfg.minSamples, cfg.maxSamples);
+    engine.estimator().setRejectOutliers(cfg.rejectOutliers);
+
+    SimResult result = {0, 0, 0, 0, 0.0, 0.0};
+    double sumSq = 0.0;
+    bool done = false;
+
+    engine.onSetVcoVoltage = [&](double v){
+        clock.sleepUs((qint64)cfg.boardLatencyUs);
+        vco.setVoltage(v);
+    };
+    engine.onPointComplete = [&](double v, double freq){
+        double err = freq - vco.freqAt(v);
+        sumSq += err*err;
+        result.maxErrorHz = qMax(result.maxErrorHz, qAbs(err));
+        result.points++;
+    };
+    engine.onComplete = [&](){ done = true; };
+
+    engine.start();
+    while(!done){
+        engine.step();
+    }
+
+    result.sweeps = engine.sweeps();
+    result.simTimeUs = clock.nowUs();
+    result.rmsErrorHz = result.points > 0 ? qSqrt(sumSq/result.points) : 0.0;
+    result.cpuTimeUs = processCpuUs() - cpuStartUs;
+    return result;
+}
@@ -0,0 +1,91 @@
+#ifndef CALSIMULATION_H
+#define CALSIMULATION_H
+
+#include <QRandomGenerator>
+#include <QString>
+
+#include "clock.h"
+#include "spectrumanalyzer.h"
+
+struct SimConfig {
+    double f0Hz = 20.0e6;               // VCO frequency at 0 V
+    double k1HzPerV = 4.0e6;            // linear tuning gain
+    double k2HzPerV2 = -2.5e5;          // curvature
+    double noiseHz = 15.0;              // marker reading noise, 1 sigma
+    int tracePoints = SPECAN_TRACE_POINTS; // marker snaps to these across the span
+    double outlierProb = 0.02;          // chance a reading lands on a spur
+    double outlierHz = 5000.0;
+    double settleTauUs = 40000.0;       // VCO settling time constant
+    double sweepTimeS = 0.05;
+    double commandLatencyUs = 2000.0;   // SCPI write/read turnaround
+    double boardLatencyUs = 500.0;      // queued signal plus serial write to the board
+    double toleranceHz = 10.0;
+    int minSamples = 2;
+    int maxSamples = 30;
+    bool rejectOutliers = true;
+    quint32 seed = 1;
+};
+
+struct SimResult {
+    int points;
+    int sweeps;
+    qint64 simTimeUs;
+    qint64 cpuTimeUs;
+    double rmsErrorHz;
+    double maxErrorHz;
+};
+
+/**
+ * @brief The SimVco class is a VCO with a quadratic tuning curve that slews
+ * to each new DAC voltage with a first order response.
+ */
+class SimVco
+{
+public:
+    SimVco(const SimConfig& cfg, Clock* clock);
+    void setVoltage(double voltage);
+    double freqNow();
+    double freqAt(double voltage) const;
+
+private:
+    const SimConfig& m_cfg;
+    Clock* m_clock;
+    double m_fromHz;
+    double m_toHz;
+    qint64 m_changedUs;
+};
+
+/**
+ * @brief The SimAnalyzer class answers marker queries with the VCO frequency
+ * plus noise and the odd spur, snapped to the trace point spacing of the
+ * current span like the Siglent's marker, and charges
+ * virtual time for every command.
+ */
+class SimAnalyzer : public SpectrumAnalyzer
+{
+public:
+    SimAnalyzer(const SimConfig& cfg, Clock* clock, SimVco* vco);
+    double getMarkerFreq() override;
+    double getSweepTime() override;
+    double getMarkerResolution() override;
+    void setRefLevel(int ref) override;
+    void setStartFreq(double start) override;
+    void setStopFreq(double stop) override;
+    void setFreqSpan(double span) override;
+    void setRBW(double rbw) override;
+    void setContPeak(bool on_off) override;
+    void setMarkerAsCenter() override;
+
+private:
+    void command();
+    const SimConfig& m_cfg;
+    Clock* m_clock;
+    SimVco* m_vco;
+    QRandomGenerator m_rng;
+    double m_startHz;
+    double m_spanHz;
+};
+
+SimResult runSimulatedCalibration(const SimConfig& cfg);
+
+#endif // CALSIMULATION_H
@@ -0,0 +1,94 @@
+#include "channelscanner.h"
+#include <QtMath>
+
+ChannelScanner::ChannelScanner()
+{
+    m_current = 0;
+    m_locked = false;
+    m_markHz = 0.0;
+    m_spaceHz = 0.0;
+}
+
+void ChannelScanner::setChannels(const QList<double>& freqs){
+    m_channels.clear();
+    for(auto freq : freqs){
+        m_channels.append({freq, 0.0, 0});
+    }
+    reset();
+}
+
+/**
+ * @brief ChannelScanner::rangeChannels channel list from start to stop
+ * inclusive in step Hz
+ */
+QList<double> ChannelScanner::rangeChannels(double start, double stop, double step){
+    QList<double> freqs;
+    if(step > 0.0){
+        int n = (int)((stop - start)/step + 0.5);
+        for(int i = 0; i <= n; i++){
+            freqs.append(start + i*step);
+        }
+    }
+    return freqs;
+}
+
+void ChannelScanner::setTones(double markHz, double spaceHz){
+    m_markHz = markHz;
+    m_spaceHz = spaceHz;
+}
+
+void ChannelScanner::reset(){
+    m_current = 0;
+    m_locked = false;
+}
+
+double ChannelScanner::currentFreq() const{
+    return m_channels.isEmpty() ? 0.0 : m_channels[m_current].freq;
+}
+
+/**
+ * @brief ChannelScanner::extraSamples
+ * @param probe tone samples from the probe
+ * @return further samples to take on this channel, 0 when the probe was silent
+ */
+int ChannelScanner::extraSamples(const QList<float>& probe) const{
+    if(countHits(probe) == 0){
+        return 0;
+    }
+    return qMax(0, SCAN_DWELL_SAMPLES - probe.length());
+}
+
+/**
+ * @brief ChannelScanner::finishChannel score the samples taken on the current
+ * channel and move on, unless the channel was busy enough to lock onto
+ * @return true if the scan locked onto the current channel
+ */
+bool ChannelScanner::finishChannel(const QList<float>& samples){
+    if(m_channels.isEmpty()){
+        return false;
+    }
+    ScanChannel& ch = m_channels[m_current];
+    double ratio = samples.isEmpty() ? 0.0 : (double)countHits(samples) / (double)samples.length();
+    ch.activity = (1.0 - SCAN_ACTIVITY_ALPHA)*ch.activity + SCAN_ACTIVITY_ALPHA*ratio;
+    ch.visits++;
+
+    if(samples.length() >= SCAN_DWELL_SAMPLES && ratio >= SCAN_LOCK_THRESHOLD){
+        m_locked = true;
+        return true;
+    }
+    m_current = (m_current + 1) % m_channels.length();
+    return false;
+}
+
+int ChannelScanner::countHits(const QList<float>& samples) const{
+    int hits = 0;
+    for(auto tone : samples){
+        if(tone <= 0.0f){
+            continue; // no carrier
+        }
+        if(qAbs(tone - m_markHz) <= SCAN_TONE_TOL_HZ || qAbs(tone - m_spaceHz) <= SCAN_TONE_TOL_HZ){
+            hits++;
+        }
+    }
+    return hits;
+}
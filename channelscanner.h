@@ -0,0 +1,58 @@
+#ifndef CHANNELSCANNER_H
+#define CHANNELSCANNER_H
+
+#include <QList>
+#include <QVector>
+
+#define SCAN_PROBE_SAMPLES      2
+#define SCAN_SETTLE_SAMPLES     1       // tone reads thrown away while the receiver settles after a retune
+#define SCAN_DWELL_SAMPLES      16
+#define SCAN_TONE_TOL_HZ        60.0
+#define SCAN_ACTIVITY_ALPHA     0.3
+#define SCAN_LOCK_THRESHOLD     0.6
+
+struct ScanChannel {
+    double freq;
+    double activity;
+    quint32 visits;
+};
+
+/**
+ * @brief The ChannelScanner class decides where a scan goes next. Each channel
+ * gets a short probe; only when the probe hears mark or space energy does it
+ * get the full dwell. Every visit folds the fraction of samples that landed on
+ * mark or space into an exponentially weighted activity index, and a channel
+ * that is busy for a whole dwell locks the scan.
+ */
+class ChannelScanner
+{
+public:
+    ChannelScanner();
+
+    void setChannels(const QList<double>& freqs);
+    static QList<double> rangeChannels(double start, double stop, double step);
+    void setTones(double markHz, double spaceHz);
+    void reset();
+
+    bool isEmpty() const { return m_channels.isEmpty(); }
+    bool isLocked() const { return m_locked; }
+    double currentFreq() const;
+    int currentIndex() const { return m_current; }
+    const QVector<ScanChannel>& channels() const { return m_channels; }
+
+    int probeSamples() const { return SCAN_PROBE_SAMPLES; }
+    int settleSamples() const { return SCAN_SETTLE_SAMPLES; }
+    int extraSamples(const QList<float>& probe) const;
+    bool finishChannel(const QList<float>& samples);
+
+private:
+    int countHits(const QList<float>& samples) const;
+
+    QVector<ScanChannel> m_channels;
+    int m_current;
+    bool m_locked;
+    double m_markHz;
+    double m_spaceHz;
+};
+
+#endif // CHANNELSCANNER_H
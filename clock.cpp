@@ -0,0 +1,52 @@
+#include "clock.h"
+#include <QThread>
+
+#ifdef Q_OS_UNIX
+#include <time.h>
+#include <errno.h>
+#else
+#include <QElapsedTimer>
+#endif
+
+/**
+ * @brief Clock::system the process wide real clock, for code that isn't
+ * handed one
+ */
+Clock* Clock::system(){
+    static SystemClock clock;
+    return &clock;
+}
+
+qint64 SystemClock::nowNs(){
+#ifdef Q_OS_UNIX
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (qint64)ts.tv_sec*1000000000LL + ts.tv_nsec;
+#else
+    static QElapsedTimer timer;
+    if(!timer.isValid()){
+        timer.start();
+    }
+    return timer.nsecsElapsed();
+#endif
+}
+
+/**
+ * @brief SystemClock::sleepUntilNs sleep on the absolute deadline, so time
+ * lost to a late wakeup or a signal isn't added on top
+ */
+void SystemClock::sleepUntilNs(qint64 deadlineNs){
+#ifdef Q_OS_LINUX
+    struct timespec ts;
+    ts.tv_sec = deadlineNs/1000000000LL;
+    ts.tv_nsec = deadlineNs%1000000000LL;
+    if(deadlineNs > nowNs()){
+        while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, nullptr) == EINTR){}
+    }
+#else
+    qint64 remaining = deadlineNs - nowNs();
+    if(remaining > 0){
+        QThread::usleep((unsigned long)(remaining/1000));
+    }
+#endif
+}
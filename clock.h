@@ -0,0 +1,49 @@
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QtGlobal>
+
+/**
+ * @brief The Clock class is the time source for code that has to wait on
+ * hardware. The real thing sleeps; the virtual one just moves time forward,
+ * which lets the calibration flow run against simulated instruments in
+ * milliseconds.
+ */
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual qint64 nowNs() = 0;
+    virtual void sleepUntilNs(qint64 deadlineNs) = 0;
+
+    qint64 nowUs() { return nowNs()/1000; }
+    qint64 nowMs() { return nowNs()/1000000; }
+    void sleepUs(qint64 us) { if(us > 0) sleepUntilNs(nowNs() + us*1000); }
+
+    static Clock* system();
+};
+
+/**
+ * @brief The SystemClock class reads CLOCK_MONOTONIC where there is one, so
+ * its timestamps can be compared across processes and fed to
+ * clock_nanosleep(). Every instance shares the same epoch.
+ */
+class SystemClock : public Clock
+{
+public:
+    qint64 nowNs() override;
+    void sleepUntilNs(qint64 deadlineNs) override;
+};
+
+class VirtualClock : public Clock
+{
+public:
+    VirtualClock() : m_nowNs(0) {}
+    qint64 nowNs() override { return m_nowNs; }
+    void sleepUntilNs(qint64 deadlineNs) override { m_nowNs = qMax(m_nowNs, deadlineNs); }
+
+private:
+    qint64 m_nowNs;
+};
+
+#endif // CLOCK_H
@@ -0,0 +1,148 @@
+#include "connectionmanager.h"
+#include <QDebug>
+
+#define STOP_TIMEOUT_MS 3000
+
+ConnectionManager::ConnectionManager(QObject *parent)
+    : QObject{parent}
+{
+    qRegisterMetaType<LinkState>("LinkState");
+    qRegisterMetaType<RttyState>("RttyState");
+    m_boardManager = nullptr;
+}
+
+ConnectionManager::~ConnectionManager(){
+    disconnectAll();
+}
+
+/**
+ * @brief ConnectionManager::connectBoard start the worker thread for the
+ * board on comport. Returns immediately; progress is reported through
+ * statusChanged() and boardReady() fires each time the link comes up.
+ * @return the board's worker, already running
+ */
+Rtty* ConnectionManager::connectBoard(QString comport, SerialBackend backend){
+    if(m_boards.contains(comport)){
+        return m_boards[comport];
+    }
+    if(m_stations.contains(comport)){
+        // a port has one owner, and the station's must be closed before the Rtty opens it
+        m_boardManager->removeBoard(m_stations.take(comport));
+    }
+
+    Rtty* board = new Rtty(comport, backend);
+    m_boards.insert(comport, board);
+    connect(board, &Rtty::connectionStatus, this, [this, comport, board](LinkState state, QString detail){
+        updateState(comport, state, detail);
+        if(state == LinkState::CONNECTED){
+            emit boardReady(board);
+        }
+    });
+    board->start();
+    return board;
+}
+
+/**
+ * @brief ConnectionManager::connectSpecAn start the analyzer thread, which
+ * opens, identifies and configures the instrument before it starts polling
+ * @return the analyzer's worker, already running
+ */
+SiglentSpecAn* ConnectionManager::connectSpecAn(QString ipAddr){
+    if(m_specAns.contains(ipAddr)){
+        return m_specAns[ipAddr];
+    }
+
+    SiglentSpecAn* specAn = new SiglentSpecAn(ipAddr);
+    m_specAns.insert(ipAddr, specAn);
+    connect(specAn, &SiglentSpecAn::connectionStatus, this, [this, ipAddr](LinkState state, QString detail){
+        updateState(ipAddr, state, detail);
+    });
+    connect(specAn, &SiglentSpecAn::identity, this, [this, specAn](QString idn){
+        emit specAnReady(specAn, idn);
+    });
+    specAn->start();
+    return specAn;
+}
+
+/**
+ * @brief ConnectionManager::connectStation drive the board on comport from
+ * the shared multiplexed BoardManager rather than a thread of its own. For
+ * racks of boards that only need polling.
+ * @return the board's station id in boardManager(), -1 if comport already
+ * has a worker of its own from connectBoard()
+ */
+int ConnectionManager::connectStation(QString comport){
+    if(m_boards.contains(comport)){
+        return -1;
+    }
+    if(m_stations.contains(comport)){
+        return m_stations[comport];
+    }
+    int id = boardManager()->addBoard(comport);
+    m_stations.insert(comport, id);
+    return id;
+}
+
+BoardManager* ConnectionManager::boardManager(){
+    if(m_boardManager == nullptr){
+        m_boardManager = new BoardManager(this);
+        connect(m_boardManager, &BoardManager::stationStatus, this, [this](int id, QString comport, LinkState state, QString detail){
+            Q_UNUSED(id);
+            updateState(comport, state, detail);
+        });
+    }
+    return m_boardManager;
+}
+
+void ConnectionManager::disconnectAll(){
+    for(auto board : m_boards){
+        board->requestInterruption();
+    }
+    for(auto specAn : m_specAns){
+        specAn->requestInterruption();
+    }
+    for(auto board : m_boards){
+        stopThread(board);
+        delete board;
+    }
+    for(auto specAn : m_specAns){
+        stopThread(specAn);
+        delete specAn;
+    }
+    if(m_boardManager != nullptr){
+        m_boardManager->stop();
+        delete m_boardManager;
+        m_boardManager = nullptr;
+    }
+    m_boards.clear();
+    m_specAns.clear();
+    m_stations.clear();
+    m_states.clear();
+}
+
+LinkState ConnectionManager::state(QString device) const{
+    return m_states.value(device, LinkState::DISCONNECTED);
+}
+
+/*******************/
+/* PRIVATE METHODS */
+/*******************/
+
+/**
+ * @brief ConnectionManager::stopThread ask a worker to stop and wait for it.
+ * Workers check for interruption in every long transfer, so one that's still
+ * running after STOP_TIMEOUT_MS is stuck in a driver call; killing it would
+ * leave its locks held and the board half written, so keep waiting.
+ */
+void ConnectionManager::stopThread(QThread* thread){
+    thread->requestInterruption();
+    if(!thread->wait(STOP_TIMEOUT_MS)){
+        qWarning() << thread->metaObject()->className() << "did not stop within" << STOP_TIMEOUT_MS << "ms, still waiting";
+        thread->wait();
+    }
+}
+
+void ConnectionManager::updateState(QString device, LinkState state, QString detail){
+    m_states[device] = state;
+    emit statusChanged(device, state, detail);
+}
@@ -0,0 +1,49 @@
+#ifndef CONNECTIONMANAGER_H
+#define CONNECTIONMANAGER_H
+
+#include <QObject>
+#include <QMap>
+
+#include "reconnect.h"
+#include "rtty.h"
+#include "siglentspecan.h"
+#include "boardmanager.h"
+
+/**
+ * @brief The ConnectionManager class starts boards and instruments on their
+ * own worker threads. Each worker opens, identifies and configures its device
+ * and retries with backoff, so nothing here blocks the GUI thread and a slow
+ * device never holds up the others.
+ */
+class ConnectionManager : public QObject
+{
+    Q_OBJECT
+public:
+    explicit ConnectionManager(QObject *parent = nullptr);
+    ~ConnectionManager();
+
+    Rtty* connectBoard(QString comport, SerialBackend backend = SerialBackend::QT);
+    SiglentSpecAn* connectSpecAn(QString ipAddr);
+    int connectStation(QString comport);
+    BoardManager* boardManager();
+    void disconnectAll();
+
+    LinkState state(QString device) const;
+
+signals:
+    void statusChanged(QString device, LinkState state, QString detail);
+    void boardReady(Rtty* board);
+    void specAnReady(SiglentSpecAn* specAn, QString identity);
+
+private:
+    void stopThread(QThread* thread);
+    void updateState(QString device, LinkState state, QString detail);
+
+    QMap<QString, Rtty*> m_boards;
+    QMap<QString, SiglentSpecAn*> m_specAns;
+    QMap<QString, LinkState> m_states;
+    QMap<QString, int> m_stations;
+    BoardManager* m_boardManager;
+};
+
+#endif // CONNECTIONMANAGER_H
@@ -0,0 +1,116 @@
+#include "diagnosticsdialog.h"
+#include "instrumentation.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QPushButton>
+#include <QHeaderView>
+#include <QFileDialog>
+#include <QFile>
+
+#define DIAG_REFRESH_MS 500
+
+DiagnosticsDialog::DiagnosticsDialog(QWidget *parent)
+    : QDialog{parent}
+{
+    setWindowTitle("Diagnostics");
+    resize(760, 480);
+
+    m_histTable = new QTableWidget(0, 8, this);
+    m_histTable->setHorizontalHeaderLabels({"Timer", "Count", "Min (us)", "Mean (us)",
+                                            "p50 (us)", "p90 (us)", "p99 (us)", "Max (us)"});
+    m_histTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_histTable->verticalHeader()->setVisible(false);
+    m_histTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    m_counterTable = new QTableWidget(0, 2, this);
+    m_counterTable->setHorizontalHeaderLabels({"Counter", "Value"});
+    m_counterTable->horizontalHeader()->setSectionResizeMode(0, QHeaderView::Stretch);
+    m_counterTable->verticalHeader()->setVisible(false);
+    m_counterTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
+    QPushButton* resetBtn = new QPushButton("RESET", this);
+    QPushButton* jsonBtn = new QPushButton("EXPORT JSON", this);
+    QPushButton* csvBtn = new QPushButton("EXPORT CSV", this);
+    connect(resetBtn, &QPushButton::clicked, this, &DiagnosticsDialog::resetStats);
+    connect(jsonBtn, &QPushButton::clicked, this, &DiagnosticsDialog::exportJson);
+    connect(csvBtn, &QPushButton::clicked, this, &DiagnosticsDialog::exportCsv);
+
+    QHBoxLayout* btnLayout = new QHBoxLayout();
+    btnLayout->addStretch();
+    btnLayout->addWidget(resetBtn);
+    btnLayout->addWidget(jsonBtn);
+    btnLayout->addWidget(csvBtn);
+
+    QVBoxLayout* layout = new QVBoxLayout(this);
+    layout->addWidget(m_histTable, 3);
+    layout->addWidget(m_counterTable, 1);
+    layout->addLayout(btnLayout);
+
+    m_refreshTimer = new QTimer(this);
+    connect(m_refreshTimer, &QTimer::timeout, this, &DiagnosticsDialog::refresh);
+    m_refreshTimer->start(DIAG_REFRESH_MS);
+    refresh();
+}
+
+/**
+ * @brief DiagnosticsDialog::refresh redraw both tables from the current
+ * contents of the instrumentation registry
+ */
+void DiagnosticsDialog::refresh(){
+    auto usec = [](double ns){ return QString::number(ns/1000.0, 'f', 1); };
+
+    auto hists = Instrumentation::instance().histograms();
+    m_histTable->setRowCount(hists.length());
+    int row = 0;
+    for(auto hist : hists){
+        QStringList cols = {
+            hist->name(),
+            QString::number(hist->count()),
+            usec(hist->minNs()),
+            usec(hist->meanNs()),
+            usec(hist->percentileNs(50.0)),
+            usec(hist->percentileNs(90.0)),
+            usec(hist->percentileNs(99.0)),
+            usec(hist->maxNs())
+        };
+        for(int col = 0; col < cols.length(); col++){
+            m_histTable->setItem(row, col, new QTableWidgetItem(cols[col]));
+        }
+        row++;
+    }
+
+    auto ctrs = Instrumentation::instance().counters();
+    m_counterTable->setRowCount(ctrs.length());
+    row = 0;
+    for(auto ctr : ctrs){
+        m_counterTable->setItem(row, 0, new QTableWidgetItem(ctr->name()));
+        m_counterTable->setItem(row, 1, new QTableWidgetItem(QString::number(ctr->value())));
+        row++;
+    }
+}
+
+void DiagnosticsDialog::exportJson(){
+    QString path = QFileDialog::getSaveFileName(this, "Export Diagnostics", "diagnostics.json", "JSON (*.json)");
+    if(!path.isEmpty()){
+        QFile file(path);
+        if(file.open(QIODevice::WriteOnly)){
+            file.write(Instrumentation::instance().toJson());
+        }
+    }
+}
+
+void DiagnosticsDialog::exportCsv(){
+    QString path = QFileDialog::getSaveFileName(this, "Export Diagnostics", "diagnostics.csv", "CSV (*.csv)");
+    if(!path.isEmpty()){
+        QFile file(path);
+        if(file.open(QIODevice::WriteOnly)){
+            file.write(Instrumentation::instance().toCsv());
+        }
+    }
+}
+
+void DiagnosticsDialog::resetStats(){
+    Instrumentation::instance().resetAll();
+    refresh();
+}
@@ -0,0 +1,28 @@
+#ifndef DIAGNOSTICSDIALOG_H
+#define DIAGNOSTICSDIALOG_H
+
+#include <QDialog>
+#include <QTableWidget>
+#include <QTimer>
+
+class DiagnosticsDialog : public QDialog
+{
+    Q_OBJECT
+public:
+    explicit DiagnosticsDialog(QWidget *parent = nullptr);
+
+public slots:
+    void refresh();
+
+private slots:
+    void exportJson();
+    void exportCsv();
+    void resetStats();
+
+private:
+    QTableWidget* m_histTable;
+    QTableWidget* m_counterTable;
+    QTimer* m_refreshTimer;
+};
+
+#endif // DIAGNOSTICSDIALOG_H
@@ -0,0 +1,113 @@
+#include "fieldscheduler.h"
+#include "rttyboard.h"
+
+#include <QThread>
+#include <QtMath>
+#include <cstring>
+
+FieldScheduler::FieldScheduler()
+{
+    m_clock = Clock::system();
+    m_errorHist = Instrumentation::instance().histogram("rtty.scheduleError");
+}
+
+/**
+ * @brief FieldScheduler::play send every batch of waveform at its offset
+ * from now. Runs at time critical priority for the duration.
+ * @param send called with each batch when its deadline arrives, must not
+ * return until the batch has been written out
+ * @return how far behind plan the writes actually went out. If the thread
+ * is interrupted the last batch, which leaves the PA ramped down, is sent
+ * straight away and the rest skipped.
+ */
+ScheduleReport FieldScheduler::play(const FieldWaveform& waveform,
+                                    std::function<void(QList<QPair<uint8_t, uint32_t>>&)> send){
+    ScheduleReport report = {0, 0.0, 0.0};
+    if(waveform.isEmpty()){
+        return report;
+    }
+
+    QThread* thread = QThread::currentThread();
+    QThread::Priority oldPriority = thread->priority();
+    thread->setPriority(QThread::TimeCriticalPriority);
+
+    double totalErrorUs = 0.0;
+    qint64 start = m_clock->nowNs();
+    for(int i = 0; i < waveform.length(); i++){
+        if(thread->isInterruptionRequested() && i < waveform.length() - 1){
+            QList<QPair<uint8_t, uint32_t>> fields = waveform.last().fields;
+            send(fields);
+            break;
+        }
+        const TimedFieldBatch& batch = waveform[i];
+        qint64 deadline = start + batch.offsetNs;
+        sleepUntilNs(deadline);
+        QList<QPair<uint8_t, uint32_t>> fields = batch.fields;
+        send(fields);
+        // send() returns once the batch has left the host, which is the
+        // moment that matters
+        qint64 late = m_clock->nowNs() - deadline;
+
+        m_errorHist->record(late);
+        double lateUs = late/1000.0;
+        totalErrorUs += lateUs;
+        report.maxErrorUs = qMax(report.maxErrorUs, lateUs);
+        report.batches++;
+    }
+    report.meanErrorUs = report.batches > 0 ? totalErrorUs/report.batches : 0.0;
+
+    thread->setPriority(oldPriority);
+    return report;
+}
+
+/**
+ * @brief FieldScheduler::paRamp raised cosine ramp of FIELD_PA_DAC_VOLTAGE,
+ * which keeps key clicks out of the neighbouring channels
+ */
+FieldWaveform FieldScheduler::paRamp(float fromV, float toV, qint64 durationNs, int steps, qint64 startNs){
+    FieldWaveform wf;
+    if(steps < 1){
+        steps = 1;
+    }
+    for(int i = 0; i <= steps; i++){
+        double t = (double)i/steps;
+        float v = fromV + (toV - fromV)*(float)(0.5 - 0.5*qCos(M_PI*t));
+        uint32_t raw;
+        memcpy(&raw, &v, 4);
+        TimedFieldBatch batch;
+        batch.offsetNs = startNs + (qint64)(t*durationNs);
+        batch.fields.append(QPair<uint8_t, uint32_t>(FIELD_PA_DAC_VOLTAGE, raw));
+        wf.append(batch);
+    }
+    return wf;
+}
+
+/**
+ * @brief FieldScheduler::txKeySequence ramp the PA up, hand the board one
+ * character of data per character time, then ramp back down
+ * @param baud RTTY baud rate, characters go out every RTTY_BITS_PER_CHAR bits
+ * @param paLevelV PA DAC voltage while keyed
+ */
+FieldWaveform FieldScheduler::txKeySequence(const QByteArray& data, double baud, float paLevelV, qint64 rampNs){
+    FieldWaveform wf = paRamp(0.0f, paLevelV, rampNs);
+    qint64 charNs = (qint64)(RTTY_BITS_PER_CHAR/baud*1.0e9);
+    qint64 t = rampNs;
+    for(auto c : data){
+        TimedFieldBatch batch;
+        batch.offsetNs = t;
+        batch.fields.append(QPair<uint8_t, uint32_t>(FIELD_TX_DATA, (uint8_t)c));
+        wf.append(batch);
+        t += charNs;
+    }
+    wf.append(paRamp(paLevelV, 0.0f, rampNs, PA_RAMP_STEPS, t));
+    return wf;
+}
+
+/**
+ * @brief FieldScheduler::sleepUntilNs sleep on the absolute deadline minus
+ * SCHED_SPIN_NS, then spin out the remainder
+ */
+void FieldScheduler::sleepUntilNs(qint64 deadline){
+    m_clock->sleepUntilNs(deadline - SCHED_SPIN_NS);
+    while(m_clock->nowNs() < deadline){}
+}
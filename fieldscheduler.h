@@ -0,0 +1,57 @@
+#ifndef FIELDSCHEDULER_H
+#define FIELDSCHEDULER_H
+
+#include <QList>
+#include <QPair>
+#include <QByteArray>
+#include <functional>
+#include <inttypes.h>
+
+#include "instrumentation.h"
+#include "clock.h"
+
+#define SCHED_SPIN_NS           50000
+#define PA_RAMP_STEPS           32
+#define PA_RAMP_NS              5000000
+#define RTTY_BITS_PER_CHAR      7.5
+
+struct TimedFieldBatch {
+    qint64 offsetNs;
+    QList<QPair<uint8_t, uint32_t>> fields;
+};
+
+typedef QList<TimedFieldBatch> FieldWaveform;
+
+struct ScheduleReport {
+    int batches;
+    double meanErrorUs;
+    double maxErrorUs;
+};
+
+/**
+ * @brief The FieldScheduler class plays a precomputed list of field writes
+ * against absolute deadlines on the monotonic clock. It sleeps until just
+ * before each deadline and spins the rest of the way, so the write goes out
+ * within microseconds of plan instead of at the mercy of usleep granularity.
+ * Lateness of every batch is recorded.
+ */
+class FieldScheduler
+{
+public:
+    FieldScheduler();
+
+    ScheduleReport play(const FieldWaveform& waveform,
+                        std::function<void(QList<QPair<uint8_t, uint32_t>>&)> send);
+
+    static FieldWaveform paRamp(float fromV, float toV, qint64 durationNs = PA_RAMP_NS,
+                                int steps = PA_RAMP_STEPS, qint64 startNs = 0);
+    static FieldWaveform txKeySequence(const QByteArray& data, double baud, float paLevelV,
+                                       qint64 rampNs = PA_RAMP_NS);
+
+private:
+    Clock* m_clock;
+    LatencyHistogram* m_errorHist;
+    void sleepUntilNs(qint64 deadline);
+};
+
+#endif // FIELDSCHEDULER_H
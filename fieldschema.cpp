@@ -0,0 +1,116 @@
+#include "fieldschema.h"
+#include <cstring>
+
+FieldSchema::FieldSchema()
+{
+    clear();
+}
+
+void FieldSchema::clear(){
+    m_fields.clear();
+    for(int i = 0; i < 256; i++){
+        m_index[i] = -1;
+    }
+}
+
+void FieldSchema::add(const FieldDesc& desc){
+    if(m_index[desc.id] >= 0){
+        m_fields[m_index[desc.id]] = desc;
+        return;
+    }
+    m_index[desc.id] = m_fields.length();
+    m_fields.append(desc);
+}
+
+/**
+ * @brief FieldSchema::appendPage parse one CMD_READ_SCHEMA reply
+ * @param payload reply payload
+ * @param total set to the number of fields the board says it has
+ * @return false if the page was malformed
+ */
+bool FieldSchema::appendPage(const QByteArray& payload, int* total){
+    const uint8_t* raw = (const uint8_t*)payload.constData();
+    int len = payload.length();
+    if(len < 1){
+        return false;
+    }
+    *total = raw[0];
+
+    int i = 1;
+    while(i < len){
+        if(len - i < 3){
+            return false;
+        }
+        FieldDesc desc;
+        desc.id = raw[i];
+        desc.type = (FieldType)raw[i + 1];
+        int nameLen = raw[i + 2];
+        i += 3;
+        if(len - i < nameLen + 1){
+            return false;
+        }
+        desc.name = QString::fromLatin1((const char*)raw + i, nameLen);
+        i += nameLen;
+        int unitLen = raw[i];
+        i++;
+        if(len - i < unitLen){
+            return false;
+        }
+        desc.unit = QString::fromLatin1((const char*)raw + i, unitLen);
+        i += unitLen;
+        add(desc);
+    }
+    return true;
+}
+
+const FieldDesc* FieldSchema::field(uint8_t id) const{
+    int idx = m_index[id];
+    return idx < 0 ? nullptr : &m_fields[idx];
+}
+
+const FieldDesc* FieldSchema::field(const QString& name) const{
+    for(const auto& desc : m_fields){
+        if(desc.name == name){
+            return &desc;
+        }
+    }
+    return nullptr;
+}
+
+QList<uint8_t> FieldSchema::ids() const{
+    QList<uint8_t> retval;
+    for(const auto& desc : m_fields){
+        retval.append(desc.id);
+    }
+    return retval;
+}
+
+double FieldSchema::toDouble(FieldType type, uint32_t raw){
+    switch(type){
+    case FieldType::I32:
+        return (double)(int32_t)raw;
+    case FieldType::F32:{
+        float f;
+        memcpy(&f, &raw, 4);
+        return (double)f;
+    }case FieldType::BOOL:
+        return raw != 0 ? 1.0 : 0.0;
+    case FieldType::U32:
+    default:
+        return (double)raw;
+    }
+}
+
+QVariant FieldSchema::toVariant(FieldType type, uint32_t raw){
+    switch(type){
+    case FieldType::I32:
+        return QVariant((int)(int32_t)raw);
+    case FieldType::F32:
+        return QVariant(toDouble(type, raw));
+    case FieldType::BOOL:
+        return QVariant(raw != 0);
+    case FieldType::U32:
+    default:
+        return QVariant((uint)raw);
+    }
+}
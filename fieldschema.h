@@ -0,0 +1,61 @@
+#ifndef FIELDSCHEMA_H
+#define FIELDSCHEMA_H
+
+#include <QString>
+#include <QVector>
+#include <QVariant>
+#include <inttypes.h>
+
+/*
+ * CMD_READ_SCHEMA
+ *
+ * request payload:  [first]                     index of the first entry wanted
+ * reply payload:    [total][entry][entry]...    as many entries as fit in a frame
+ * entry:            [id][type][nameLen][name...][unitLen][unit...]
+ *
+ * The host keeps asking from the next index until it has all total entries.
+ */
+
+enum class FieldType : uint8_t {
+    U32 = 0,
+    I32 = 1,
+    F32 = 2,
+    BOOL = 3
+};
+
+struct FieldDesc {
+    uint8_t id;
+    FieldType type;
+    QString name;
+    QString unit;
+};
+
+/**
+ * @brief The FieldSchema class describes the fields a board exposes, either
+ * as reported by the board itself or the built in fields_enum layout for
+ * firmware that predates CMD_READ_SCHEMA.
+ */
+class FieldSchema
+{
+public:
+    FieldSchema();
+
+    void clear();
+    void add(const FieldDesc& desc);
+    bool appendPage(const QByteArray& payload, int* total);
+
+    int count() const { return m_fields.length(); }
+    const QVector<FieldDesc>& fields() const { return m_fields; }
+    const FieldDesc* field(uint8_t id) const;
+    const FieldDesc* field(const QString& name) const;
+    QList<uint8_t> ids() const;
+
+    static double toDouble(FieldType type, uint32_t raw);
+    static QVariant toVariant(FieldType type, uint32_t raw);
+
+private:
+    QVector<FieldDesc> m_fields;
+    int m_index[256];
+};
+
+#endif // FIELDSCHEMA_H
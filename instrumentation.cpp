@@ -0,0 +1,200 @@
+#include "instrumentation.h"
+
+#include <QtAlgorithms>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <limits>
+
+/*********************/
+/* LATENCY HISTOGRAM */
+/*********************/
+
+LatencyHistogram::LatencyHistogram(const QString& name)
+    : m_name(name)
+{
+    reset();
+}
+
+/**
+ * @brief LatencyHistogram::bucketIndex values below SUB_BUCKETS get a bucket
+ * each, above that every power of two gets SUB_BUCKETS linear sub-buckets
+ */
+int LatencyHistogram::bucketIndex(quint64 value){
+    if(value < SUB_BUCKETS){
+        return (int)value;
+    }
+    int msb = 63 - qCountLeadingZeroBits(value);
+    int magnitude = msb - SUB_BUCKET_BITS + 1;
+    int sub = (int)((value >> (msb - SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1));
+    return magnitude*SUB_BUCKETS + sub;
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int index){
+    if(index < SUB_BUCKETS){
+        return (quint64)index;
+    }
+    int magnitude = index / SUB_BUCKETS;
+    quint64 sub = (quint64)(index % SUB_BUCKETS);
+    quint64 width = 1ULL << (magnitude - 1);
+    return ((SUB_BUCKETS + sub) << (magnitude - 1)) + width - 1;
+}
+
+void LatencyHistogram::record(qint64 ns){
+    quint64 value = ns < 0 ? 0 : (quint64)ns;
+    m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(value, std::memory_order_relaxed);
+
+    quint64 cur = m_min.load(std::memory_order_relaxed);
+    while(value < cur && !m_min.compare_exchange_weak(cur, value, std::memory_order_relaxed)){}
+    cur = m_max.load(std::memory_order_relaxed);
+    while(value > cur && !m_max.compare_exchange_weak(cur, value, std::memory_order_relaxed)){}
+}
+
+void LatencyHistogram::reset(){
+    for(int i = 0; i < NUM_BUCKETS; i++){
+        m_buckets[i].store(0, std::memory_order_relaxed);
+    }
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_min.store(std::numeric_limits<quint64>::max(), std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+quint64 LatencyHistogram::count() const{
+    return m_count.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::minNs() const{
+    return count() == 0 ? 0 : (qint64)m_min.load(std::memory_order_relaxed);
+}
+
+qint64 LatencyHistogram::maxNs() const{
+    return (qint64)m_max.load(std::memory_order_relaxed);
+}
+
+double LatencyHistogram::meanNs() const{
+    quint64 n = count();
+    return n == 0 ? 0.0 : (double)m_sum.load(std::memory_order_relaxed) / (double)n;
+}
+
+/**
+ * @brief LatencyHistogram::percentileNs
+ * @param pct percentile in the range 0-100
+ * @return upper bound of the bucket holding the requested percentile
+ */
+qint64 LatencyHistogram::percentileNs(double pct) const{
+    quint64 n = count();
+    if(n == 0){
+        return 0;
+    }
+    quint64 target = (quint64)((pct/100.0)*(double)n + 0.5);
+    if(target < 1){
+        target = 1;
+    }
+    quint64 seen = 0;
+    for(int i = 0; i < NUM_BUCKETS; i++){
+        seen += m_buckets[i].load(std::memory_order_relaxed);
+        if(seen >= target){
+            return qMin((qint64)bucketUpperBound(i), maxNs());
+        }
+    }
+    return maxNs();
+}
+
+/*******************/
+/* INSTRUMENTATION */
+/*******************/
+
+Instrumentation& Instrumentation::instance(){
+    static Instrumentation inst;
+    return inst;
+}
+
+Instrumentation::~Instrumentation(){
+    qDeleteAll(m_histograms);
+    qDeleteAll(m_counters);
+}
+
+LatencyHistogram* Instrumentation::histogram(const QString& name){
+    QMutexLocker lock(&m_registryMtx);
+    auto it = m_histograms.find(name);
+    if(it == m_histograms.end()){
+        it = m_histograms.insert(name, new LatencyHistogram(name));
+    }
+    return it.value();
+}
+
+EventCounter* Instrumentation::counter(const QString& name){
+    QMutexLocker lock(&m_registryMtx);
+    auto it = m_counters.find(name);
+    if(it == m_counters.end()){
+        it = m_counters.insert(name, new EventCounter(name));
+    }
+    return it.value();
+}
+
+QList<LatencyHistogram*> Instrumentation::histograms(){
+    QMutexLocker lock(&m_registryMtx);
+    return m_histograms.values();
+}
+
+QList<EventCounter*> Instrumentation::counters(){
+    QMutexLocker lock(&m_registryMtx);
+    return m_counters.values();
+}
+
+void Instrumentation::resetAll(){
+    for(auto hist : histograms()){
+        hist->reset();
+    }
+    for(auto ctr : counters()){
+        ctr->reset();
+    }
+}
+
+QByteArray Instrumentation::toJson(){
+    QJsonArray hists;
+    for(auto hist : histograms()){
+        QJsonObject obj;
+        obj["name"] = hist->name();
+        obj["count"] = (qint64)hist->count();
+        obj["min_ns"] = hist->minNs();
+        obj["mean_ns"] = hist->meanNs();
+        obj["p50_ns"] = hist->percentileNs(50.0);
+        obj["p90_ns"] = hist->percentileNs(90.0);
+        obj["p99_ns"] = hist->percentileNs(99.0);
+        obj["p999_ns"] = hist->percentileNs(99.9);
+        obj["max_ns"] = hist->maxNs();
+        hists.append(obj);
+    }
+    QJsonObject ctrs;
+    for(auto ctr : counters()){
+        ctrs[ctr->name()] = ctr->value();
+    }
+    QJsonObject root;
+    root["histograms"] = hists;
+    root["counters"] = ctrs;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QByteArray Instrumentation::toCsv(){
+    QByteArray csv("name,count,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,p999_ns,max_ns\n");
+    for(auto hist : histograms()){
+        csv += QString("%1,%2,%3,%4,%5,%6,%7,%8,%9\n")
+                   .arg(hist->name())
+                   .arg(hist->count())
+                   .arg(hist->minNs())
+                   .arg(hist->meanNs(), 0, 'f', 1)
+                   .arg(hist->percentileNs(50.0))
+                   .arg(hist->percentileNs(90.0))
+                   .arg(hist->percentileNs(99.0))
+                   .arg(hist->percentileNs(99.9))
+                   .arg(hist->maxNs()).toUtf8();
+    }
+    for(auto ctr : counters()){
+        csv += QString("%1,%2,,,,,,,\n").arg(ctr->name()).arg(ctr->value()).toUtf8();
+    }
+    return csv;
+}
@@ -0,0 +1,107 @@
+#ifndef INSTRUMENTATION_H
+#define INSTRUMENTATION_H
+
+#include <QString>
+#include <QMap>
+#include <QMutex>
+#include <QElapsedTimer>
+#include <atomic>
+#include <inttypes.h>
+
+/**
+ * @brief The LatencyHistogram class is a lock-free log-linear (HDR style)
+ * histogram of durations in nanoseconds. Each power of two is split into 16
+ * sub-buckets, so any recorded value is resolved to within ~6%.
+ */
+class LatencyHistogram
+{
+public:
+    static constexpr int SUB_BUCKET_BITS = 4;
+    static constexpr int SUB_BUCKETS = 1 << SUB_BUCKET_BITS;
+    static constexpr int NUM_BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+    explicit LatencyHistogram(const QString& name);
+
+    void record(qint64 ns);
+    void reset();
+
+    QString name() const { return m_name; }
+    quint64 count() const;
+    qint64 minNs() const;
+    qint64 maxNs() const;
+    double meanNs() const;
+    qint64 percentileNs(double pct) const;
+
+private:
+    static int bucketIndex(quint64 value);
+    static quint64 bucketUpperBound(int index);
+
+    QString m_name;
+    std::atomic<quint64> m_buckets[NUM_BUCKETS];
+    std::atomic<quint64> m_count;
+    std::atomic<quint64> m_sum;
+    std::atomic<quint64> m_min;
+    std::atomic<quint64> m_max;
+};
+
+/**
+ * @brief The EventCounter class is a lock-free signed counter. Used both for
+ * monotonic event counts and for gauges like queued signal backlog.
+ */
+class EventCounter
+{
+public:
+    explicit EventCounter(const QString& name) : m_name(name), m_value(0) {}
+    void add(qint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    qint64 value() const { return m_value.load(std::memory_order_relaxed); }
+    void reset() { m_value.store(0, std::memory_order_relaxed); }
+    QString name() const { return m_name; }
+
+private:
+    QString m_name;
+    std::atomic<qint64> m_value;
+};
+
+/**
+ * @brief The Instrumentation class is the process wide registry of histograms
+ * and counters. Lookup takes a mutex, so hot paths should look their
+ * histogram up once and keep the pointer; recording never locks.
+ */
+class Instrumentation
+{
+public:
+    static Instrumentation& instance();
+
+    LatencyHistogram* histogram(const QString& name);
+    EventCounter* counter(const QString& name);
+    QList<LatencyHistogram*> histograms();
+    QList<EventCounter*> counters();
+    void resetAll();
+
+    QByteArray toJson();
+    QByteArray toCsv();
+
+private:
+    Instrumentation() = default;
+    ~Instrumentation();
+    QMutex m_registryMtx;
+    QMap<QString, LatencyHistogram*> m_histograms;
+    QMap<QString, EventCounter*> m_counters;
+};
+
+/**
+ * @brief The LatencyTimer class records the time between its construction
+ * and destruction into a histogram.
+ */
+class LatencyTimer
+{
+public:
+    explicit LatencyTimer(LatencyHistogram* hist) : m_hist(hist) { m_timer.start(); }
+    ~LatencyTimer() { m_hist->record(m_timer.nsecsElapsed()); }
+
+private:
+    LatencyHistogram* m_hist;
+    QElapsedTimer m_timer;
+};
+
+#endif // INSTRUMENTATION_H
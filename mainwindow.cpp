@@ -2,24 +2,83 @@
 #include "./ui_mainwindow.h"
 
 #include <QSerialPortInfo>
+#include <QMenu>
+#include <QInputDialog>
+#include <QFileDialog>
+
+#define TX_PA_LEVEL_V       2.5f
+#define STATE_REFRESH_MS    100
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
     , ui(new Ui::MainWindow)
 {
     ui->setupUi(this);
-    rttyBoard = nullptr;
     rttyThread = nullptr;
     specAn = nullptr;
+    diagnostics = nullptr;
+    waterfall = nullptr;
+    telemetry = nullptr;
+    m_serialBackend = SerialBackend::QT;
+    m_txVerifying = false;
+    m_modeBeforeTxVerify = RttyBoard::Mode::IDLE;
+
+    connections = new ConnectionManager(this);
+    connect(connections, &ConnectionManager::statusChanged, this, &MainWindow::updateConnectionStatus);
+    connect(connections, &ConnectionManager::specAnReady, this, [this](SiglentSpecAn*, QString idn){
+        ui->specAnIdnLabel->setText(idn);
+    });
+
+    m_guiStateHist = Instrumentation::instance().histogram("gui.updateRadioState");
+    m_stateSkipped = Instrumentation::instance().counter("gui.radioState.skipped");
+
+    // the label samples the published state at display rate instead of
+    // taking a queued copy of every poll
+    m_stateVersion = 0;
+    m_stateTimer = new QTimer(this);
+    m_stateTimer->setInterval(STATE_REFRESH_MS);
+    connect(m_stateTimer, &QTimer::timeout, this, &MainWindow::pollRadioState);
+
+    QMenu* viewMenu = ui->menubar->addMenu("View");
+    viewMenu->addAction("Waterfall", this, &MainWindow::showWaterfall);
+
+    QMenu* toolsMenu = ui->menubar->addMenu("Tools");
+    toolsMenu->addAction("Diagnostics...", this, &MainWindow::showDiagnostics);
+    toolsMenu->addAction("Benchmark Link Rates", this, &MainWindow::runLinkBenchmark);
+    QAction* lowLatencyAction = toolsMenu->addAction("Low Latency Serial");
+    lowLatencyAction->setCheckable(true);
+    lowLatencyAction->setEnabled(SerialTransport::available(SerialBackend::POSIX));
+    lowLatencyAction->setToolTip("Use the native tty backend for the next board connection");
+    connect(lowLatencyAction, &QAction::toggled, this, [this](bool on){
+        m_serialBackend = on ? SerialBackend::POSIX : SerialBackend::QT;
+        ui->statusbar->showMessage(on ? "Native low latency serial on next connect" : "QSerialPort on next connect");
+    });
+    toolsMenu->addAction("Monitor All Ports", this, &MainWindow::monitorAllPorts);
+    QAction* telemetryAction = toolsMenu->addAction("Export Telemetry");
+    telemetryAction->setCheckable(true);
+    telemetryAction->setToolTip("Publish board data to shared memory and accept commands on a local socket");
+    connect(telemetryAction, &QAction::toggled, this, &MainWindow::setTelemetryExport);
+    toolsMenu->addSeparator();
+    toolsMenu->addAction("Start Channel Scan...", this, &MainWindow::startChannelScan);
+    toolsMenu->addAction("Stop Channel Scan", this, &MainWindow::stopChannelScan);
+    toolsMenu->addSeparator();
+    QAction* afcAction = toolsMenu->addAction("AFC");
+    afcAction->setCheckable(true);
+    connect(afcAction, &QAction::toggled, this, &MainWindow::setAfcEnabled);
+    toolsMenu->addAction("Load VCO Calibration...", this, &MainWindow::loadVcoCalibration);
+    toolsMenu->addAction("Save VCO Calibration...", this, &MainWindow::saveVcoCalibration);
+    toolsMenu->addAction("Upload VCO Calibration", this, &MainWindow::uploadVcoCalibration);
+    toolsMenu->addAction("Calibration Tolerance...", this, &MainWindow::setCalTolerance);
+    toolsMenu->addAction("Verify TX", this, &MainWindow::verifyTx);
 }
 
 MainWindow::~MainWindow()
 {
-    specAn->terminate();
-    rttyThread->terminate();
-    delete specAn;
-    delete rttyThread;
-    delete rttyBoard;
+    m_stateTimer->stop();
+    if(telemetry != nullptr){
+        telemetry->stop();
+    }
+    connections->disconnectAll();
     delete ui;
 }
 
@@ -37,6 +96,7 @@ void MainWindow::updatePeakFreq(double freqMHz){
 }
 
 void MainWindow::updateRadioState(RttyState state){
+    LatencyTimer timer(m_guiStateHist);
     QString txt;
     txt += QString("MODE:        %1\r\n").arg(state.mode);
     txt += QString("FREQ:        %1 MHz\r\n").arg(state.freqMHz, 0, 'f', '4');
@@ -53,6 +113,32 @@ void MainWindow::updateRadioState(RttyState state){
     ui->radioStateLabel->setText(txt);
 }
 
+/**
+ * @brief MainWindow::pollRadioState refresh the state label from the board
+ * thread's latest snapshot, if there is a new one
+ */
+void MainWindow::pollRadioState(){
+    if(rttyThread == nullptr){
+        return;
+    }
+    RttyState state;
+    quint64 version = rttyThread->stateSnapshot(&state);
+    if(version == m_stateVersion){
+        return;
+    }
+    if(m_stateVersion > 0 && version > m_stateVersion + 1){
+        m_stateSkipped->add(version - m_stateVersion - 1);
+    }
+    m_stateVersion = version;
+    updateRadioState(state);
+}
+
+void MainWindow::updateConnectionStatus(QString device, LinkState state, QString detail){
+    Q_UNUSED(device);
+    Q_UNUSED(state);
+    ui->statusbar->showMessage(detail);
+}
+
 void MainWindow::on_refreshComportsBtn_clicked()
 {
     ui->comportComboBox->clear();
@@ -73,15 +159,42 @@ void MainWindow::on_comportComboBox_activated(int index)
 
 void MainWindow::on_connectBtn_clicked()
 {
-    if(m_comport.length() > 3){
-        rttyThread = new Rtty(m_comport);
+    if(m_comport.length() > 3 && rttyThread == nullptr){
+        rttyThread = connections->connectBoard(m_comport, m_serialBackend);
 
         // CONNECT SIGNALS AND SLOTS
         connect(rttyThread, &Rtty::rxTone, ui->rxToneLcdNum, qOverload<double>(&QLCDNumber::display));    //
         connect(rttyThread, &Rtty::rxData, this, &MainWindow::updateRxData);
-        connect(rttyThread, &Rtty::radioState, this, &MainWindow::updateRadioState);
-
-        rttyThread->start();
+        m_stateVersion = 0;
+        m_stateTimer->start();
+        connect(rttyThread, &Rtty::scanActivity, this, [this](double freq, double activity){
+            ui->statusbar->showMessage(QString("SCAN %1 MHz  activity %2").arg(freq/1.0e6, 0, 'f', 4).arg(activity, 0, 'f', 2));
+        });
+        connect(rttyThread, &Rtty::scanLocked, this, [this](double freq){
+            ui->statusbar->showMessage(QString("SCAN locked on %1 MHz").arg(freq/1.0e6, 0, 'f', 4));
+        });
+        connect(rttyThread, &Rtty::afcCorrection, this, [this](double errorHz, double correctionHz){
+            ui->statusbar->showMessage(QString("AFC error %1 Hz  correction %2 Hz").arg(errorHz, 0, 'f', 1).arg(correctionHz, 0, 'f', 1));
+        });
+        connect(rttyThread, &Rtty::waveformComplete, this, [this](int batches, double meanErrorUs, double maxErrorUs){
+            ui->statusbar->showMessage(QString("TX done: %1 writes, timing error mean %2 us max %3 us")
+                                       .arg(batches).arg(meanErrorUs, 0, 'f', 1).arg(maxErrorUs, 0, 'f', 1));
+        });
+        connect(rttyThread, &Rtty::calUploadResult, this, [this](bool ok, bool skipped, int bytesSent, double elapsedMs){
+            if(skipped){
+                ui->statusbar->showMessage("VCO calibration already on the board");
+            }else if(ok){
+                ui->statusbar->showMessage(QString("VCO calibration uploaded: %1 bytes in %2 ms").arg(bytesSent).arg(elapsedMs, 0, 'f', 0));
+            }else{
+                ui->statusbar->showMessage("VCO calibration upload failed or not supported by the firmware");
+            }
+        });
+        connect(rttyThread, &Rtty::calUploadRefused, this, [this](QString reason){
+            ui->statusbar->showMessage(QString("VCO calibration not uploaded: %1").arg(reason));
+        });
+        connect(rttyThread, &Rtty::linkBenchmarkResult, this, [this](qint32 rate, double readsPerSec){
+            ui->statusbar->showMessage(QString("%1 baud: %2 field reads/s").arg(rate).arg(readsPerSec, 0, 'f', 0));
+        });
     }
 }
 
@@ -109,6 +222,10 @@ void MainWindow::on_startTxBtn_clicked()
     if(rttyThread != nullptr){
         rttyThread->setMode(RttyBoard::Mode::TX);
         ui->currentModeLabel->setText("TX");
+        QString text = ui->txDataPlainTextEdit->toPlainText();
+        if(!text.isEmpty()){
+            rttyThread->transmit(text.toLatin1(), TX_PA_LEVEL_V);
+        }
     }
 }
 
@@ -117,7 +234,12 @@ void MainWindow::on_startVcoCalBtn_clicked()
 {
     if(rttyThread != nullptr && specAn != nullptr){
         connect(specAn, &SiglentSpecAn::setVCOVoltage, rttyThread, &Rtty::setVCOVoltage);
-        connect(specAn, &SiglentSpecAn::calPointComplete, rttyThread, &Rtty::setVCOCalFreq);
+        connect(specAn, &SiglentSpecAn::calPointComplete, rttyThread, &Rtty::addCalPoint);
+        connect(specAn, &SiglentSpecAn::calibrationComplete, rttyThread, &Rtty::uploadCalCurve);
+        connect(specAn, &SiglentSpecAn::calPointStats, this, [this](double freq, double uncertaintyHz, int samples, int rejected){
+            ui->statusbar->showMessage(QString("CAL %1 MHz +/- %2 Hz (%3 sweeps, %4 rejected)")
+                                       .arg(freq/1.0e6, 0, 'f', 6).arg(uncertaintyHz, 0, 'f', 1).arg(samples + rejected).arg(rejected));
+        });
 
         rttyThread->setMode(RttyBoard::Mode::CALIBRATE_VCO);
         ui->currentModeLabel->setText("CALIBRATE VCO");
@@ -129,15 +251,10 @@ void MainWindow::on_startVcoCalBtn_clicked()
 void MainWindow::on_connectSpecAnBtn_clicked()
 {
     QString ipAddr = ui->specAnComboBox->currentText();
-    if(ipAddr.length() > 3){
-        specAn = new SiglentSpecAn(ipAddr, this);
-        ui->specAnIdnLabel->setText(specAn->getIdentity());
-        specAn->setStartFreq(10.0e6);
-        specAn->setStopFreq(40.0e6);
-        specAn->setRBW(10000.0);
-        specAn->setContPeak(true);
+    if(ipAddr.length() > 3 && specAn == nullptr){
+        ui->specAnIdnLabel->setText("Connecting...");
+        specAn = connections->connectSpecAn(ipAddr);
         connect(specAn, &SiglentSpecAn::peakFreqMHz, ui->specAnPeakFreqLCDNum, qOverload<double>(&QLCDNumber::display));
-        specAn->start();
     }
 }
 
@@ -154,3 +271,221 @@ void MainWindow::on_setVcoVoltageBtn_clicked()
     }
 }
 
+
+void MainWindow::showDiagnostics()
+{
+    if(diagnostics == nullptr){
+        diagnostics = new DiagnosticsDialog(this);
+    }
+    diagnostics->show();
+    diagnostics->raise();
+}
+
+
+void MainWindow::runLinkBenchmark()
+{
+    if(rttyThread != nullptr){
+        ui->statusbar->showMessage("Benchmarking link rates...");
+        rttyThread->runLinkBenchmark();
+    }
+}
+
+/**
+ * @brief MainWindow::monitorAllPorts poll every listed port that no board
+ * worker owns, all from the shared multiplexed board manager
+ */
+void MainWindow::monitorAllPorts(){
+    int added = 0;
+    for(int i = 0; i < ui->comportComboBox->count(); i++){
+        QString port = ui->comportComboBox->itemText(i);
+        if(connections->connectStation(port) >= 0){
+            added++;
+        }
+    }
+    ui->statusbar->showMessage(QString("Monitoring %1 ports").arg(added));
+}
+
+
+void MainWindow::startChannelScan()
+{
+    if(rttyThread != nullptr){
+        bool ok = false;
+        QString range = QInputDialog::getText(this, "Channel Scan", "Start, stop, step (MHz)",
+                                              QLineEdit::Normal, "14.000, 14.350, 0.005", &ok);
+        QStringList parts = range.split(',');
+        if(!ok || parts.length() != 3){
+            return;
+        }
+        double start = parts[0].trimmed().toDouble()*1.0e6;
+        double stop = parts[1].trimmed().toDouble()*1.0e6;
+        double step = parts[2].trimmed().toDouble()*1.0e6;
+        rttyThread->startScan(ChannelScanner::rangeChannels(start, stop, step));
+    }
+}
+
+
+void MainWindow::stopChannelScan()
+{
+    if(rttyThread != nullptr){
+        rttyThread->stopScan();
+    }
+}
+
+
+void MainWindow::showWaterfall()
+{
+    if(specAn == nullptr){
+        ui->statusbar->showMessage("Connect the spectrum analyzer first");
+        return;
+    }
+    if(waterfall == nullptr){
+        waterfall = new WaterfallWidget(this);
+        waterfall->setWindowFlags(Qt::Window);
+        waterfall->setWindowTitle("Waterfall");
+        waterfall->resize(800, 400);
+        connect(specAn, &SiglentSpecAn::traceData, waterfall, &WaterfallWidget::addTrace);
+    }
+    specAn->setWaterfallEnabled(true);
+    waterfall->show();
+    waterfall->raise();
+}
+
+
+void MainWindow::setAfcEnabled(bool enabled)
+{
+    if(rttyThread != nullptr){
+        rttyThread->setAfcEnabled(enabled);
+    }
+}
+
+
+void MainWindow::loadVcoCalibration()
+{
+    if(rttyThread != nullptr){
+        QString path = QFileDialog::getOpenFileName(this, "Load VCO Calibration", QString(), "CSV (*.csv)");
+        if(path.isEmpty()){
+            return;
+        }
+        if(!rttyThread->loadCalCurve(path)){
+            ui->statusbar->showMessage(QString("Could not read a VCO calibration from %1").arg(path));
+            return;
+        }
+        rttyThread->uploadCalCurve();
+    }
+}
+
+
+void MainWindow::uploadVcoCalibration()
+{
+    if(rttyThread != nullptr){
+        rttyThread->uploadCalCurve();
+    }
+}
+
+
+/**
+ * @brief MainWindow::setTelemetryExport share the connected board with local
+ * processes: a shared memory ring and a control socket, both named after the
+ * comport
+ */
+void MainWindow::setTelemetryExport(bool enabled)
+{
+    if(telemetry == nullptr){
+        telemetry = new TelemetryExporter(this);
+    }
+    if(!enabled){
+        telemetry->stop();
+        ui->statusbar->showMessage("Telemetry export stopped");
+        return;
+    }
+    if(rttyThread == nullptr){
+        ui->statusbar->showMessage("Connect a board before exporting telemetry");
+        return;
+    }
+    if(!telemetry->start(rttyThread, TelemetryExporter::defaultName(m_comport))){
+        ui->statusbar->showMessage("Could not open the telemetry control socket");
+    }else if(telemetry->ringName().isEmpty()){
+        ui->statusbar->showMessage(QString("Control socket %1, no shared memory ring on this platform").arg(telemetry->serverName()));
+    }else{
+        ui->statusbar->showMessage(QString("Telemetry in shm %1, control socket %2").arg(telemetry->ringName(), telemetry->serverName()));
+    }
+}
+
+
+/**
+ * @brief MainWindow::verifyTx key the board and measure mark, space, shift
+ * and relative power in one analyzer sweep, against the tones in the latest
+ * radio state. The board goes back to its previous mode with the result.
+ */
+void MainWindow::verifyTx()
+{
+    RttyState state;
+    if(rttyThread == nullptr || specAn == nullptr || rttyThread->stateSnapshot(&state) == 0){
+        ui->statusbar->showMessage("Connect a board and the analyzer to verify TX");
+        return;
+    }
+    if(m_txVerifying){
+        ui->statusbar->showMessage("TX verify already running");
+        return;
+    }
+    connect(specAn, &SiglentSpecAn::txKeyRequest, rttyThread, &Rtty::keyTestPattern, Qt::UniqueConnection);
+    connect(specAn, &SiglentSpecAn::txVerifyResult, this, &MainWindow::showTxVerifyResult, Qt::UniqueConnection);
+
+    m_modeBeforeTxVerify = (RttyBoard::Mode)state.mode;
+    m_modeLabelBeforeTxVerify = ui->currentModeLabel->text();
+    if(!rttyThread->setMode(RttyBoard::Mode::TX)
+            || !specAn->verifyTx(state.freqMHz*1.0e6, state.markFreq, state.spaceFreq, state.baudrate)){
+        rttyThread->setMode(m_modeBeforeTxVerify);
+        ui->statusbar->showMessage("Board or analyzer busy, try Verify TX again");
+        return;
+    }
+    m_txVerifying = true;
+    ui->currentModeLabel->setText("TX");
+    ui->statusbar->showMessage("Verifying TX...");
+}
+
+
+void MainWindow::showTxVerifyResult(TxVerifyResult result)
+{
+    if(m_txVerifying && rttyThread != nullptr){
+        m_txVerifying = false;
+        if(rttyThread->setMode(m_modeBeforeTxVerify)){
+            ui->currentModeLabel->setText(m_modeLabelBeforeTxVerify);
+        }
+    }
+    if(!result.found){
+        ui->statusbar->showMessage("TX verify: mark and space tones not found");
+        return;
+    }
+    ui->statusbar->showMessage(QString("TX verify %1: mark off by %2 Hz, space off by %3 Hz, shift %4 Hz (off by %5 Hz), mark/space %6 dB")
+                               .arg(result.pass ? "PASS" : "FAIL")
+                               .arg(result.markErrorHz, 0, 'f', 1)
+                               .arg(result.spaceErrorHz, 0, 'f', 1)
+                               .arg(result.shiftHz, 0, 'f', 1)
+                               .arg(result.shiftErrorHz, 0, 'f', 1)
+                               .arg(result.powerRatioDb, 0, 'f', 1));
+}
+
+
+void MainWindow::saveVcoCalibration()
+{
+    if(rttyThread != nullptr){
+        QString path = QFileDialog::getSaveFileName(this, "Save VCO Calibration", "vco_cal.csv", "CSV (*.csv)");
+        if(!path.isEmpty() && !rttyThread->saveCalCurve(path)){
+            ui->statusbar->showMessage(QString("Could not write %1").arg(path));
+        }
+    }
+}
+
+
+void MainWindow::setCalTolerance()
+{
+    if(specAn != nullptr){
+        bool ok = false;
+        double tol = QInputDialog::getDouble(this, "Calibration Tolerance", "Frequency tolerance (Hz)",
+                                             EST_DEFAULT_TOL_HZ, 0.1, 10000.0, 1, &ok);
+        if(ok){
+            specAn->setCalTolerance(tol);
+        }
+    }
+}
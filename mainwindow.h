@@ -2,11 +2,16 @@
 #define MAINWINDOW_H
 
 #include <QMainWindow>
+#include <QTimer>
 
 #include <stdint.h>
 #include "rttyboard.h"
 #include "rtty.h"
 #include "siglentspecan.h"
+#include "diagnosticsdialog.h"
+#include "connectionmanager.h"
+#include "waterfallwidget.h"
+#include "telemetryexporter.h"
 
 QT_BEGIN_NAMESPACE
 namespace Ui { class MainWindow; }
@@ -24,6 +29,7 @@ public slots:
     void updateRxData(uint8_t data);
     void updatePeakFreq(double freqMHz);
     void updateRadioState(RttyState state);
+    void updateConnectionStatus(QString device, LinkState state, QString detail);
 
 private slots:
     void on_refreshComportsBtn_clicked();
@@ -44,11 +50,52 @@ private slots:
 
     void on_setVcoVoltageBtn_clicked();
 
+    void showDiagnostics();
+
+    void runLinkBenchmark();
+
+    void monitorAllPorts();
+
+    void startChannelScan();
+
+    void stopChannelScan();
+
+    void showWaterfall();
+
+    void setAfcEnabled(bool enabled);
+
+    void loadVcoCalibration();
+
+    void saveVcoCalibration();
+
+    void uploadVcoCalibration();
+
+    void setCalTolerance();
+
+    void setTelemetryExport(bool enabled);
+
+    void verifyTx();
+
+    void showTxVerifyResult(TxVerifyResult result);
+
+    void pollRadioState();
+
 private:
     Ui::MainWindow *ui;
     QString m_comport;
-    RttyBoard* rttyBoard;
+    SerialBackend m_serialBackend;
     Rtty* rttyThread;
     SiglentSpecAn* specAn;
+    ConnectionManager* connections;
+    DiagnosticsDialog* diagnostics;
+    WaterfallWidget* waterfall;
+    TelemetryExporter* telemetry;
+    LatencyHistogram* m_guiStateHist;
+    EventCounter* m_stateSkipped;
+    QTimer* m_stateTimer;
+    quint64 m_stateVersion;
+    bool m_txVerifying;
+    RttyBoard::Mode m_modeBeforeTxVerify;
+    QString m_modeLabelBeforeTxVerify;
 };
 #endif // MAINWINDOW_H
@@ -0,0 +1,136 @@
+#include "measurementestimator.h"
+#include <QtMath>
+#include <algorithm>
+#include <limits>
+
+MeasurementEstimator::MeasurementEstimator(double toleranceHz, int minSamples, int maxSamples)
+{
+    m_tolerance = toleranceHz;
+    m_resolution = 0.0;
+    m_rejectOutliers = true;
+    m_minSamples = minSamples;
+    m_maxSamples = maxSamples;
+    reset();
+}
+
+void MeasurementEstimator::reset(){
+    m_samples.clear();
+    m_n = 0;
+    m_mean = 0.0;
+    m_m2 = 0.0;
+}
+
+void MeasurementEstimator::setTolerance(double toleranceHz){
+    m_tolerance = toleranceHz;
+}
+
+/**
+ * @brief MeasurementEstimator::setResolution smallest step a reading can
+ * take, e.g. the marker's trace point spacing. Kept across reset().
+ */
+void MeasurementEstimator::setResolution(double resolutionHz){
+    m_resolution = resolutionHz;
+}
+
+/**
+ * @brief MeasurementEstimator::addSample
+ * @param x one reading
+ * @return true once no more readings are needed
+ */
+bool MeasurementEstimator::addSample(double x){
+    m_samples.append(x);
+    refit();
+    return isDone();
+}
+
+bool MeasurementEstimator::isDone() const{
+    return converged() || m_samples.length() >= m_maxSamples;
+}
+
+bool MeasurementEstimator::converged() const{
+    return m_n >= m_minSamples && halfWidth() <= m_tolerance;
+}
+
+/**
+ * @brief MeasurementEstimator::stddev sample standard deviation of the
+ * inliers, at least the resolution/sqrt(12) of a uniformly quantised reading
+ */
+double MeasurementEstimator::stddev() const{
+    if(m_n < 2){
+        return 0.0;
+    }
+    return qMax(qSqrt(m_m2/(m_n - 1)), m_resolution/qSqrt(12.0));
+}
+
+/**
+ * @brief MeasurementEstimator::halfWidth half width of the 95% confidence
+ * interval of the mean, infinite until there are two inliers
+ */
+double MeasurementEstimator::halfWidth() const{
+    if(m_n < 2){
+        return std::numeric_limits<double>::infinity();
+    }
+    return tQuantile(m_n - 1)*stddev()/qSqrt(m_n);
+}
+
+/**
+ * @brief MeasurementEstimator::refit redo the outlier split against the
+ * median/MAD of every reading so far and run Welford over the inliers. At
+ * most EST_MAX_SAMPLES readings, so starting over each time is cheap and an
+ * early outlier can't poison the estimate.
+ */
+void MeasurementEstimator::refit(){
+    double med = median(m_samples);
+    QVector<double> dev;
+    dev.reserve(m_samples.length());
+    for(auto x : m_samples){
+        dev.append(qAbs(x - med));
+    }
+    // floor the spread so a run of identical readings doesn't reject everything else
+    double sigma = qMax(1.4826*median(dev), m_tolerance/2.0);
+
+    m_n = 0;
+    m_mean = 0.0;
+    m_m2 = 0.0;
+    for(auto x : m_samples){
+        if(m_rejectOutliers && m_samples.length() >= 3 && qAbs(x - med) > EST_OUTLIER_K*sigma){
+            continue;
+        }
+        m_n++;
+        double delta = x - m_mean;
+        m_mean += delta/m_n;
+        m_m2 += delta*(x - m_mean);
+    }
+}
+
+double MeasurementEstimator::median(QVector<double> values){
+    if(values.isEmpty()){
+        return 0.0;
+    }
+    int mid = values.length()/2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    double hi = values[mid];
+    if(values.length() % 2 == 1){
+        return hi;
+    }
+    double lo = *std::max_element(values.begin(), values.begin() + mid);
+    return (lo + hi)/2.0;
+}
+
+/**
+ * @brief MeasurementEstimator::tQuantile two sided 95% Student t quantile
+ */
+double MeasurementEstimator::tQuantile(int df){
+    static const double table[] = {
+        12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+        2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+        2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+    };
+    if(df < 1){
+        return table[0];
+    }
+    if(df > 30){
+        return 1.96;
+    }
+    return table[df - 1];
+}
@@ -0,0 +1,57 @@
+#ifndef MEASUREMENTESTIMATOR_H
+#define MEASUREMENTESTIMATOR_H
+
+#include <QVector>
+
+#define EST_DEFAULT_TOL_HZ  10.0
+#define EST_MIN_SAMPLES     2
+#define EST_MAX_SAMPLES     30
+#define EST_OUTLIER_K       3.5
+
+/**
+ * @brief The MeasurementEstimator class decides how many readings a
+ * measurement needs. Readings more than EST_OUTLIER_K robust standard
+ * deviations (1.4826*MAD) from the median are set aside, the rest feed a
+ * Welford running mean/variance, and sampling stops as soon as the 95%
+ * confidence interval of the mean is within the tolerance. The spread is
+ * never taken as less than the quantisation of a single reading, so a run of
+ * identical readings doesn't claim a +/-0 Hz result.
+ */
+class MeasurementEstimator
+{
+public:
+    MeasurementEstimator(double toleranceHz = EST_DEFAULT_TOL_HZ,
+                         int minSamples = EST_MIN_SAMPLES, int maxSamples = EST_MAX_SAMPLES);
+
+    void reset();
+    void setTolerance(double toleranceHz);
+    void setResolution(double resolutionHz);
+    void setRejectOutliers(bool on) { m_rejectOutliers = on; }
+    bool addSample(double x);
+
+    bool isDone() const;
+    bool converged() const;
+    double mean() const { return m_mean; }
+    double stddev() const;
+    double halfWidth() const;
+    int count() const { return m_n; }
+    int rejected() const { return m_samples.length() - m_n; }
+    int total() const { return m_samples.length(); }
+
+private:
+    void refit();
+    static double median(QVector<double> values);
+    static double tQuantile(int df);
+
+    QVector<double> m_samples;
+    double m_tolerance;
+    double m_resolution;
+    bool m_rejectOutliers;
+    int m_minSamples;
+    int m_maxSamples;
+    int m_n;
+    double m_mean;
+    double m_m2;
+};
+
+#endif // MEASUREMENTESTIMATOR_H
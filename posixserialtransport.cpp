@@ -0,0 +1,322 @@
+#include "posixserialtransport.h"
+#include "clock.h"
+
+#ifdef Q_OS_LINUX
+
+#include <QDeadlineTimer>
+#include <QFile>
+#include <QFileInfo>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <linux/serial.h>
+
+static speed_t speedFor(qint32 rate){
+    switch(rate){
+    case 9600:    return B9600;
+    case 19200:   return B19200;
+    case 38400:   return B38400;
+    case 57600:   return B57600;
+    case 115200:  return B115200;
+    case 230400:  return B230400;
+    case 460800:  return B460800;
+    case 921600:  return B921600;
+    case 1000000: return B1000000;
+    case 2000000: return B2000000;
+    case 3000000: return B3000000;
+    default:      return B0;
+    }
+}
+
+PosixSerialTransport::PosixSerialTransport(const QString& port)
+{
+    m_path = port.startsWith('/') ? port : "/dev/" + port;
+    m_fd = -1;
+    m_wakeFd = -1;
+    m_reader = nullptr;
+    m_lost = false;
+    m_lowLatency = false;
+    m_headOffset = 0;
+    m_available = 0;
+    m_arrivalNs = 0;
+
+    m_wakeHist = Instrumentation::instance().histogram("serial.posix.wakeLatency");
+}
+
+PosixSerialTransport::~PosixSerialTransport(){
+    close();
+}
+
+/**
+ * @brief PosixSerialTransport::open open the tty raw at rate and start the
+ * epoll reader thread. An open port is closed first, so reopening after a
+ * lost adapter gets a fresh fd and reader.
+ */
+bool PosixSerialTransport::open(qint32 rate){
+    close();
+    m_fd = ::open(m_path.toLocal8Bit().constData(), O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if(m_fd < 0){
+        return false;
+    }
+
+    struct termios tio;
+    if(tcgetattr(m_fd, &tio) != 0){
+        close();
+        return false;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~(CSTOPB | CRTSCTS);
+    tio.c_cc[VMIN] = 1;
+    tio.c_cc[VTIME] = 0;
+    if(tcsetattr(m_fd, TCSANOW, &tio) != 0 || !setBaudRate(rate)){
+        close();
+        return false;
+    }
+    setLowLatency();
+    setLatencyTimer(POSIX_SERIAL_LATENCY_TIMER);
+
+    m_wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(m_wakeFd < 0){
+        close();
+        return false;
+    }
+    m_lost = false;
+    clear();
+    m_reader = QThread::create([this](){ readLoop(); });
+    m_reader->start(QThread::TimeCriticalPriority);
+    return true;
+}
+
+void PosixSerialTransport::close(){
+    if(m_reader != nullptr){
+        uint64_t one = 1;
+        if(::write(m_wakeFd, &one, sizeof(one)) < 0){
+            m_reader->requestInterruption();
+        }
+        m_reader->wait();
+        delete m_reader;
+        m_reader = nullptr;
+    }
+    if(m_wakeFd >= 0){
+        ::close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+    if(m_fd >= 0){
+        ::close(m_fd);
+        m_fd = -1;
+    }
+}
+
+bool PosixSerialTransport::isOpen(){
+    return m_fd >= 0;
+}
+
+bool PosixSerialTransport::lost(){
+    return !isOpen() || m_lost;
+}
+
+bool PosixSerialTransport::setBaudRate(qint32 rate){
+    speed_t speed = speedFor(rate);
+    struct termios tio;
+    if(speed == B0 || tcgetattr(m_fd, &tio) != 0){
+        return false;
+    }
+    cfsetispeed(&tio, speed);
+    cfsetospeed(&tio, speed);
+    return tcsetattr(m_fd, TCSANOW, &tio) == 0;
+}
+
+void PosixSerialTransport::clear(){
+    tcflush(m_fd, TCIOFLUSH);
+    QMutexLocker lock(&m_mtx);
+    m_chunks.clear();
+    m_headOffset = 0;
+    m_available = 0;
+}
+
+/**
+ * @brief PosixSerialTransport::write write all of data, waiting on POLLOUT
+ * if the driver's buffer is full, for at most POSIX_SERIAL_WRITE_TIMEOUT
+ * @return bytes written, short if the buffer never drained (flow control
+ * held off, device wedged), -1 if the port failed
+ */
+qint64 PosixSerialTransport::write(const QByteArray& data){
+    QDeadlineTimer deadline(POSIX_SERIAL_WRITE_TIMEOUT);
+    qint64 done = 0;
+    while(done < data.length()){
+        ssize_t n = ::write(m_fd, data.constData() + done, data.length() - done);
+        if(n > 0){
+            done += n;
+        }else if(n < 0 && errno == EAGAIN){
+            if(deadline.hasExpired()){
+                break;
+            }
+            struct pollfd pfd = {m_fd, POLLOUT, 0};
+            poll(&pfd, 1, (int)qMin((qint64)100, deadline.remainingTime()));
+        }else if(n < 0 && errno != EINTR){
+            m_lost = true;
+            return -1;
+        }
+    }
+    return done;
+}
+
+/**
+ * @brief PosixSerialTransport::waitForBytesWritten wait for the driver's
+ * output queue to drain. tcdrain() can't time out, so poll TIOCOUTQ.
+ */
+bool PosixSerialTransport::waitForBytesWritten(int timeoutMs){
+    QDeadlineTimer deadline(timeoutMs);
+    forever{
+        int queued = 0;
+        if(ioctl(m_fd, TIOCOUTQ, &queued) != 0 || queued == 0){
+            return true;
+        }
+        if(deadline.hasExpired()){
+            return false;
+        }
+        QThread::usleep(100);
+    }
+}
+
+qint64 PosixSerialTransport::bytesAvailable(){
+    QMutexLocker lock(&m_mtx);
+    return m_available;
+}
+
+/**
+ * @brief PosixSerialTransport::waitForReadyRead wakeLatency is only taken
+ * when this call actually slept, bytes already queued say nothing about it
+ */
+bool PosixSerialTransport::waitForReadyRead(int timeoutMs){
+    QMutexLocker lock(&m_mtx);
+    QDeadlineTimer deadline(timeoutMs);
+    bool blocked = false;
+    while(m_available == 0 && !m_lost){
+        blocked = true;
+        if(!m_ready.wait(&m_mtx, deadline)){
+            break;
+        }
+    }
+    if(blocked && m_available > 0){
+        m_wakeHist->record(Clock::system()->nowNs() - m_chunks.first().arrivalNs);
+    }
+    return m_available > 0;
+}
+
+qint64 PosixSerialTransport::read(char* dst, qint64 maxLen){
+    QMutexLocker lock(&m_mtx);
+    qint64 got = 0;
+    while(got < maxLen && !m_chunks.isEmpty()){
+        Chunk& head = m_chunks.first();
+        qint64 n = qMin(maxLen - got, (qint64)(head.data.length() - m_headOffset));
+        memcpy(dst + got, head.data.constData() + m_headOffset, n);
+        got += n;
+        m_headOffset += n;
+        m_arrivalNs = head.arrivalNs;
+        if(m_headOffset == head.data.length()){
+            m_chunks.removeFirst();
+            m_headOffset = 0;
+        }
+    }
+    m_available -= got;
+    return (got == 0 && m_lost) ? -1 : got;
+}
+
+QByteArray PosixSerialTransport::readAll(){
+    QByteArray data(bytesAvailable(), 0x00);
+    qint64 n = read(data.data(), data.length());
+    data.resize(qMax(n, (qint64)0));
+    return data;
+}
+
+/**
+ * @brief PosixSerialTransport::readLoop reader thread. Drains the tty each
+ * time epoll says it is readable and stamps the chunk on the way in.
+ */
+void PosixSerialTransport::readLoop(){
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = m_fd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, m_fd, &ev);
+    ev.data.fd = m_wakeFd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, m_wakeFd, &ev);
+
+    char buf[POSIX_SERIAL_READ_CHUNK];
+    struct epoll_event events[2];
+    while(!QThread::currentThread()->isInterruptionRequested()){
+        int n = epoll_wait(ep, events, 2, 100);
+        qint64 arrival = Clock::system()->nowNs();
+        if(n < 0 && errno != EINTR){
+            m_lost = true;
+            break;
+        }
+
+        bool stop = false;
+        for(int i = 0; i < n; i++){
+            if(events[i].data.fd == m_wakeFd){
+                stop = true;
+                continue;
+            }
+            if(events[i].events & (EPOLLHUP | EPOLLERR)){
+                m_lost = true;
+                stop = true;
+            }
+            ssize_t got;
+            while((got = ::read(m_fd, buf, sizeof(buf))) > 0){
+                QMutexLocker lock(&m_mtx);
+                m_chunks.append({QByteArray(buf, (int)got), arrival});
+                m_available += got;
+            }
+            if(got == 0 || (got < 0 && errno != EAGAIN && errno != EINTR)){
+                m_lost = true; // adapter unplugged
+                stop = true;
+            }
+            QMutexLocker lock(&m_mtx);
+            m_ready.wakeAll();
+        }
+        if(stop){
+            break;
+        }
+    }
+    QMutexLocker lock(&m_mtx);
+    m_ready.wakeAll();
+    lock.unlock();
+    ::close(ep);
+}
+
+/**
+ * @brief PosixSerialTransport::setLowLatency ask the serial core to push
+ * received bytes to the tty layer straight away instead of batching them
+ */
+void PosixSerialTransport::setLowLatency(){
+    struct serial_struct ss;
+    m_lowLatency = false;
+    if(ioctl(m_fd, TIOCGSERIAL, &ss) == 0){
+        ss.flags |= ASYNC_LOW_LATENCY;
+        m_lowLatency = ioctl(m_fd, TIOCSSERIAL, &ss) == 0;
+    }
+}
+
+/**
+ * @brief PosixSerialTransport::setLatencyTimer turn down the USB adapter's
+ * receive latency timer (ftdi_sio exposes it in sysfs). Needs write access
+ * to the attribute, so a udev rule or nothing.
+ */
+void PosixSerialTransport::setLatencyTimer(int ms){
+    QString name = QFileInfo(m_path).fileName();
+    QFile timer(QString("/sys/bus/usb-serial/devices/%1/latency_timer").arg(name));
+    if(timer.open(QIODevice::WriteOnly)){
+        timer.write(QByteArray::number(ms));
+    }
+}
+
+#endif // Q_OS_LINUX
@@ -0,0 +1,82 @@
+#ifndef POSIXSERIALTRANSPORT_H
+#define POSIXSERIALTRANSPORT_H
+
+#include <QtGlobal>
+
+#ifdef Q_OS_LINUX
+
+#include <QList>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include <atomic>
+
+#include "serialtransport.h"
+#include "instrumentation.h"
+
+#define POSIX_SERIAL_READ_CHUNK     4096
+#define POSIX_SERIAL_LATENCY_TIMER  1   // ms, FTDI default is 16
+#define POSIX_SERIAL_WRITE_TIMEOUT  1000    // ms a write may wait for room in the driver's buffer
+
+/**
+ * @brief The PosixSerialTransport class talks to the tty directly. The port
+ * is opened raw with VMIN=1/VTIME=0 and ASYNC_LOW_LATENCY set, and the USB
+ * adapter's latency timer is turned down where the driver exposes one.
+ * A reader thread sits in epoll_wait on the fd and stamps each chunk the
+ * moment it lands, before the driving thread is even woken.
+ *
+ * The low latency settings are best effort: a pty or an adapter without
+ * them still works, it just doesn't get faster.
+ */
+class PosixSerialTransport : public SerialTransport
+{
+public:
+    PosixSerialTransport(const QString& port);
+    ~PosixSerialTransport();
+
+    bool open(qint32 rate) override;
+    void close() override;
+    bool isOpen() override;
+    bool lost() override;
+    bool setBaudRate(qint32 rate) override;
+    void clear() override;
+    qint64 write(const QByteArray& data) override;
+    bool waitForBytesWritten(int timeoutMs) override;
+    qint64 bytesAvailable() override;
+    bool waitForReadyRead(int timeoutMs) override;
+    qint64 read(char* dst, qint64 maxLen) override;
+    QByteArray readAll() override;
+    qint64 lastArrivalNs() override { return m_arrivalNs; }
+
+    bool lowLatency() const { return m_lowLatency; }
+
+private:
+    struct Chunk {
+        QByteArray data;
+        qint64 arrivalNs;
+    };
+
+    void readLoop();
+    void setLowLatency();
+    void setLatencyTimer(int ms);
+
+    QString m_path;
+    int m_fd;
+    int m_wakeFd;
+    QThread* m_reader;
+    std::atomic<bool> m_lost;
+    bool m_lowLatency;
+
+    QMutex m_mtx;
+    QWaitCondition m_ready;
+    QList<Chunk> m_chunks;
+    int m_headOffset;
+    qint64 m_available;
+    qint64 m_arrivalNs;
+
+    LatencyHistogram* m_wakeHist;
+};
+
+#endif // Q_OS_LINUX
+
+#endif // POSIXSERIALTRANSPORT_H
@@ -0,0 +1,70 @@
+#ifndef RECONNECT_H
+#define RECONNECT_H
+
+#include <QMetaType>
+#include <QRandomGenerator>
+#include <QThread>
+
+#define RECONNECT_INITIAL_MS    250
+#define RECONNECT_MAX_MS        8000
+#define RECONNECT_POLL_MS       50
+
+enum class LinkState : int {
+    CONNECTING,
+    CONNECTED,
+    RETRYING,
+    DISCONNECTED
+};
+Q_DECLARE_METATYPE(LinkState)
+
+/**
+ * @brief The ReconnectBackoff class hands out exponentially growing retry
+ * delays with +/-25% jitter so several devices that dropped at the same time
+ * don't all hammer the bus in lock step.
+ */
+class ReconnectBackoff
+{
+public:
+    ReconnectBackoff(int initialMs = RECONNECT_INITIAL_MS, int maxMs = RECONNECT_MAX_MS)
+        : m_initialMs(initialMs), m_maxMs(maxMs), m_nextMs(initialMs), m_attempts(0) {}
+
+    int nextDelayMs(){
+        int delay = m_nextMs;
+        m_nextMs = qMin(m_nextMs*2, m_maxMs);
+        m_attempts++;
+        int jitter = delay/4;
+        return delay - jitter + (int)QRandomGenerator::global()->bounded(2*jitter + 1);
+    }
+
+    void reset(){
+        m_nextMs = m_initialMs;
+        m_attempts = 0;
+    }
+
+    int attempts() const { return m_attempts; }
+
+    /**
+     * @brief ReconnectBackoff::sleep sleep for ms in short slices so the
+     * calling thread still notices QThread::requestInterruption()
+     * @return false if the wait was interrupted
+     */
+    static bool sleep(int ms){
+        while(ms > 0){
+            if(QThread::currentThread()->isInterruptionRequested()){
+                return false;
+            }
+            int slice = qMin(ms, RECONNECT_POLL_MS);
+            QThread::msleep(slice);
+            ms -= slice;
+        }
+        return !QThread::currentThread()->isInterruptionRequested();
+    }
+
+private:
+    int m_initialMs;
+    int m_maxMs;
+    int m_nextMs;
+    int m_attempts;
+};
+
+#endif // RECONNECT_H
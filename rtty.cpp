@@ -1,15 +1,46 @@
 #include "rtty.h"
+#include <cstring>
+#include <QtMath>
 
-Rtty::Rtty(QString comport, QObject *parent)
+#define LINK_BENCHMARK_MS   2000
+#define TX_TEST_PA_LEVEL_V  2.5f
+#define TX_TEST_CHAR_A      0x15    // 10101, with start and stop bits mark and space alternate
+#define TX_TEST_CHAR_B      0x0A    // 01010
+
+Rtty::Rtty(QString comport, SerialBackend backend, QObject *parent)
     : QThread{parent}
 {
-    rttyBoard = new RttyBoard(comport, this);
+    m_comport = comport;
+    rttyBoard = new RttyBoard(comport, backend, this);
     configMtx = new QMutex();
 
+    m_mode = RttyBoard::Mode::IDLE;
+    m_freq = 0.0;
+    m_baudRate = 0.0;
+    m_vcoVoltage = 0.0;
+    m_linkRates = {460800, 921600, 2000000};
+    m_runLinkBenchmark = false;
+    m_uploadCal = false;
+    m_stateFieldsChanged = false;
+    m_scanning = false;
+    m_scanChanged = false;
+    m_afcEnabled = false;
+    m_afcChanged = false;
+    m_afcRequested = false;
+    m_afcBaseVoltage = 0.0;
+    m_afcBaseFreq = 0.0;
+    m_afcMarkHz = 0.0;
+    m_afcSpaceHz = 0.0;
+    memset(&m_state, 0, sizeof(m_state));
+
     for(uint8_t i = 0; i < NUM_FIELDS; i++){
         m_changeFieldFlags.insert(i, false);
     }
 
+    m_loopPeriodHist = Instrumentation::instance().histogram("rtty.loopPeriod");
+    m_pollHist = Instrumentation::instance().histogram("rtty.updateRttyState");
+    m_droppedUpdates = Instrumentation::instance().counter("rtty.droppedUpdates");
+
 }
 
 Rtty::~Rtty(){
@@ -17,8 +48,141 @@ Rtty::~Rtty(){
     delete configMtx;
 }
 
+/**
+ * @brief Rtty::connectBoard open and identify the board, retrying with
+ * backoff until it answers or the thread is asked to stop
+ * @return true once the board is connected
+ */
+bool Rtty::connectBoard(){
+    ReconnectBackoff backoff;
+    emit connectionStatus(LinkState::CONNECTING, QString("Opening %1").arg(m_comport));
+    forever{
+        if(rttyBoard->open() && rttyBoard->negotiateProtocol()){
+            qint32 rate = rttyBoard->negotiateLinkRate(m_linkRates);
+            rttyBoard->readSchema();
+            configMtx->lock();
+            applyStateFields();
+            m_uploadCal = m_calCurve.isValid(); // no-op if the board already has it
+            configMtx->unlock();
+            bool framed = rttyBoard->protocol() == RttyBoard::LinkProtocol::FRAMED;
+            emit connectionStatus(LinkState::CONNECTED,
+                                  QString("%1 connected (%2 link, %3 baud)").arg(m_comport, framed ? "framed" : "legacy").arg(rate));
+            return true;
+        }
+        rttyBoard->close();
+
+        int delay = backoff.nextDelayMs();
+        emit connectionStatus(LinkState::RETRYING,
+                              QString("%1 not responding, retry %2 in %3 ms").arg(m_comport).arg(backoff.attempts()).arg(delay));
+        if(!ReconnectBackoff::sleep(delay)){
+            emit connectionStatus(LinkState::DISCONNECTED, QString("%1 closed").arg(m_comport));
+            return false;
+        }
+    }
+}
+
+/**
+ * @brief Rtty::applyStateFields resolve the requested field names against
+ * the board's schema and subscribe to them. Call with configMtx held.
+ */
+void Rtty::applyStateFields(){
+    QList<uint8_t> ids;
+    for(const auto& name : m_stateFields){
+        const FieldDesc* desc = rttyBoard->schema().field(name);
+        if(desc != nullptr){
+            ids.append(desc->id);
+        }
+    }
+    rttyBoard->setSubscribedFields(ids);
+    m_stateFieldsChanged = false;
+}
+
+/**
+ * @brief Rtty::scanStep visit one channel: tune and probe in a single
+ * batch, dwell longer only if the probe heard mark or space
+ */
+void Rtty::scanStep(){
+    int idx = m_scanner.currentIndex();
+    double freq = m_scanner.currentFreq();
+
+    QList<float> tones = rttyBoard->tuneAndSampleTone(freq, m_scanner.probeSamples(), m_scanner.settleSamples());
+    int extra = m_scanner.extraSamples(tones);
+    if(extra > 0){
+        tones += rttyBoard->sampleTone(extra);
+    }
+
+    bool locked = m_scanner.finishChannel(tones);
+    emit scanActivity(freq, m_scanner.channels()[idx].activity);
+    if(locked){
+        m_scanning = false;
+        configMtx->lock();
+        m_freq = freq;
+        configMtx->unlock();
+        // AFC corrects around where the scan stopped, not the manual frequency
+        m_afcBaseFreq = freq;
+        m_afc.reset();
+        m_afcSettle.start();
+        emit scanLocked(freq);
+    }
+}
+
+/**
+ * @brief Rtty::afcStep feed one tone measurement to the AFC loop and apply
+ * its correction. With a VCO calibration curve the correction goes straight
+ * to the DAC through the local tuning slope, otherwise the board retunes.
+ * Tones measured within AFC_SETTLE_MS of the last correction are skipped.
+ */
+void Rtty::afcStep(float tone){
+    if(m_afcSettle.isValid() && m_afcSettle.elapsed() < AFC_SETTLE_MS){
+        return;
+    }
+    if(!m_afc.update(tone, m_afcMarkHz, m_afcSpaceHz)){
+        return;
+    }
+
+    double slope = 0.0;
+    if(configMtx->tryLock()){
+        slope = m_calCurve.slopeAt(m_afcBaseVoltage);
+        configMtx->unlock();
+    }else{
+        return; // try again on the next tone
+    }
+
+    if(slope != 0.0){
+        double v = m_afcBaseVoltage + m_afc.correctionHz()/slope;
+        rttyBoard->setVcoVoltage(qBound(AFC_VOLTAGE_MIN, v, AFC_VOLTAGE_MAX));
+    }else{
+        rttyBoard->setFrequency(m_afcBaseFreq + m_afc.correctionHz());
+    }
+    m_afcSettle.start();
+    emit afcCorrection(m_afc.errorHz(), m_afc.correctionHz());
+}
+
 void Rtty::run(){
+    if(!connectBoard()){
+        return;
+    }
+
+    QElapsedTimer loopTimer;
+    loopTimer.start();
     forever{
+        if(isInterruptionRequested()){
+            break;
+        }
+        if(rttyBoard->linkLost()){
+            rttyBoard->close();
+            if(!connectBoard()){
+                return;
+            }
+            // the board may have reset, push the current mode again
+            configMtx->lock();
+            m_changeFieldFlags[FIELD_MODE] = true;
+            configMtx->unlock();
+        }
+
+        m_loopPeriodHist->record(loopTimer.nsecsElapsed());
+        loopTimer.restart();
+
         /* MODE SWITCH */
         switch(m_mode){
 
@@ -28,6 +192,9 @@ void Rtty::run(){
 
             m_rxTone = rttyBoard->getRxTone();
             emit rxTone(m_rxTone);
+            if(m_afcEnabled && !m_scanning){
+                afcStep(m_rxTone);
+            }
             QThread::usleep(100);
 
             bool rxDataRdy = rttyBoard->getRxDataReady();
@@ -46,6 +213,24 @@ void Rtty::run(){
         };
 
 
+        // before the flags, so a curve upload sees every point queued ahead of it
+        QList<QPair<double, double>> calPoints;
+        m_queueMtx.lock();
+        calPoints.swap(m_calPoints);
+        m_queueMtx.unlock();
+        if(!calPoints.isEmpty()){
+            configMtx->lock();
+            for(const auto& point : calPoints){
+                m_calCurve.addPoint(point.first, point.second);
+            }
+            configMtx->unlock();
+            for(const auto& point : calPoints){
+                rttyBoard->setVcoCalFreq(point.second);
+            }
+        }
+
+        bool runBenchmark = false;
+        QByteArray calTable;
         if(configMtx->tryLock()){
             // CHECK IF IT'S TIME TO CHANGE ANY FIELDS
             if(m_changeFieldFlags[FIELD_MODE]){
@@ -56,6 +241,9 @@ void Rtty::run(){
             if(m_changeFieldFlags[FIELD_FREQ_MHZ]){
                 rttyBoard->setFrequency(m_freq);
                 m_changeFieldFlags[FIELD_FREQ_MHZ] = false;
+                m_afcBaseFreq = m_freq;
+                m_afc.reset();
+                m_afcSettle.start();
                 QThread::usleep(100);
             }
             if(m_changeFieldFlags[FIELD_BAUD_RATE]){
@@ -66,73 +254,335 @@ void Rtty::run(){
             if(m_changeFieldFlags[FIELD_VCO_DAC_VOLTAGE]){
                 rttyBoard->setVcoVoltage(m_vcoVoltage);
                 m_changeFieldFlags[FIELD_VCO_DAC_VOLTAGE] = false;
+                m_afcBaseVoltage = m_vcoVoltage;
+                m_afc.reset();
+                m_afcSettle.start();
                 QThread::usleep(100);
             }
-            if(m_changeFieldFlags[FIELD_VCO_FREQ_CAL_VALUE]){
-                rttyBoard->setVcoCalFreq(m_vcoCalFreq);
-                m_changeFieldFlags[FIELD_VCO_FREQ_CAL_VALUE] = false;
-                QThread::usleep(100);
+            if(m_stateFieldsChanged){
+                applyStateFields();
+            }
+            if(m_afcChanged){
+                if(m_afcRequested && !m_afcEnabled){
+                    // the poll may not carry these, so read them once here
+                    rttyBoard->readRttyFields({"mark_freq", "space_freq", "freq_mhz", "vco_dac_voltage"}, &m_state);
+                    m_afcMarkHz = m_state.markFreq;
+                    m_afcSpaceHz = m_state.spaceFreq;
+                    m_afcBaseVoltage = m_state.vcoDacVoltage;
+                    m_afcBaseFreq = m_state.freqMHz*1.0e6;
+                }else if(!m_afcRequested && m_afcEnabled && m_afc.correctionHz() != 0.0){
+                    // hand back the uncorrected tuning
+                    rttyBoard->setVcoVoltage(m_afcBaseVoltage);
+                    rttyBoard->setFrequency(m_afcBaseFreq);
+                }
+                m_afc.reset();
+                m_afcSettle.invalidate();
+                m_afcEnabled = m_afcRequested;
+                m_afcChanged = false;
+            }
+            if(m_scanChanged){
+                m_scanner.setChannels(m_scanFreqs);
+                m_scanning = !m_scanner.isEmpty();
+                m_scanChanged = false;
+                if(m_scanning){
+                    // the poll that keeps m_state fresh is skipped while scanning
+                    rttyBoard->readRttyFields({"mark_freq", "space_freq"}, &m_state);
+                    m_scanner.setTones(m_state.markFreq, m_state.spaceFreq);
+                }
+                if(!m_scanning){
+                    m_changeFieldFlags[FIELD_FREQ_MHZ] = true; // back to the manual frequency
+                }
+            }
+            runBenchmark = m_runLinkBenchmark;
+            m_runLinkBenchmark = false;
+            if(m_uploadCal){
+                if(m_calCurve.isValid()){
+                    calTable = m_calCurve.toTable();
+                }
+                m_uploadCal = false;
             }
             configMtx->unlock();
         }
 
-        RttyState state;
-        rttyBoard->updateRttyState(&state);
-        emit radioState(state);
+        if(!calTable.isEmpty()){
+            // the transfer can take seconds, so it runs unlocked like the benchmark
+            TableTransferReport report = rttyBoard->uploadTable(TABLE_VCO_CAL, calTable);
+            emit calUploadResult(report.ok, report.skipped, report.bytesSent, report.elapsedMs);
+        }
+
+        if(runBenchmark){
+            // LINK_BENCHMARK_MS per rate, run unlocked so setters aren't dropped meanwhile
+            auto results = rttyBoard->benchmarkLinkRates(m_linkRates, LINK_BENCHMARK_MS);
+            for(auto result : results){
+                emit linkBenchmarkResult(result.first, result.second);
+            }
+        }
+
+        FieldWaveform waveform;
+        configMtx->lock();
+        if(!m_waveforms.isEmpty()){
+            waveform = m_waveforms.takeFirst();
+        }
+        configMtx->unlock();
+        if(!waveform.isEmpty()){
+            // waveforms are built with fields_enum ids, renumber them for this board up front
+            for(auto& batch : waveform){
+                batch.fields = rttyBoard->toBoardFields(batch.fields);
+            }
+            ScheduleReport report = m_scheduler.play(waveform, [this](QList<QPair<uint8_t, uint32_t>>& fields){
+                rttyBoard->setFields(fields);
+            });
+            emit waveformComplete(report.batches, report.meanErrorUs, report.maxErrorUs);
+        }
+
+        if(m_scanning){
+            scanStep();
+            continue;
+        }
+
+        QVariantMap extra;
+        {
+            LatencyTimer timer(m_pollHist);
+            rttyBoard->updateRttyState(&m_state, &extra);
+        }
+        m_statePublisher.publish(m_state);
+        emit radioState(m_state);
+        if(!extra.isEmpty()){
+            emit extraFields(extra);
+        }
 
     }
 }
 
 
+/**
+ * @brief Rtty::stateSnapshot latest polled radio state, safe to call from any
+ * thread at any rate without touching the poll loop
+ * @return the snapshot's version, 0 until the first poll
+ */
+quint64 Rtty::stateSnapshot(RttyState* state) const{
+    return m_statePublisher.read(state);
+}
+
+/**
+ * @brief Rtty::keyingBaudRate the board's RTTY baud rate from the published
+ * snapshot, or the last one asked for before the first poll. Safe from any
+ * thread.
+ */
+double Rtty::keyingBaudRate() const{
+    RttyState state;
+    if(m_statePublisher.read(&state) > 0 && state.baudrate > 0.0f){
+        return state.baudrate;
+    }
+    return m_baudRate;
+}
+
+bool Rtty::saveCalCurve(QString path){
+    QMutexLocker lock(configMtx);
+    return m_calCurve.save(path);
+}
+
+bool Rtty::loadCalCurve(QString path){
+    QMutexLocker lock(configMtx);
+    return m_calCurve.load(path);
+}
+
+
 /* BEGIN SLOTS */
 
-void Rtty::setMode(RttyBoard::Mode mode){
+/**
+ * @brief Rtty::setMode flag a mode change for the board thread. The setters
+ * below work the same way.
+ * @return false if the board thread held the config and the change was
+ * dropped
+ */
+bool Rtty::setMode(RttyBoard::Mode mode){
     if(mode != m_mode){
         if(configMtx->tryLock()){
             m_mode = mode;
             m_changeFieldFlags[FIELD_MODE] = true;
             configMtx->unlock();
+        }else{
+            m_droppedUpdates->add();
+            return false;
         }
     }
-
+    return true;
 }
 
-void Rtty::setFrequency(double freq){
+bool Rtty::setFrequency(double freq){
     if(freq != m_freq){
         if(configMtx->tryLock()){
             m_freq = freq;
             m_changeFieldFlags[FIELD_FREQ_MHZ] = true;
             configMtx->unlock();
+        }else{
+            m_droppedUpdates->add();
+            return false;
         }
     }
+    return true;
 }
 
-void Rtty::setBaudRate(double baud){
+bool Rtty::setBaudRate(double baud){
     if(baud != m_baudRate){
         if(configMtx->tryLock()){
             m_baudRate = baud;
             m_changeFieldFlags[FIELD_BAUD_RATE] = true;
             configMtx->unlock();
+        }else{
+            m_droppedUpdates->add();
+            return false;
         }
     }
+    return true;
 }
 
-void Rtty::setVCOVoltage(double voltage){
+bool Rtty::setVCOVoltage(double voltage){
     if(voltage != m_vcoVoltage){
         if(configMtx->tryLock()){
             m_vcoVoltage = voltage;
             m_changeFieldFlags[FIELD_VCO_DAC_VOLTAGE] = true;
             configMtx->unlock();
+        }else{
+            m_droppedUpdates->add();
+            return false;
         }
     }
+    return true;
 }
 
-void Rtty::setVCOCalFreq(double freq){
-    if(freq != m_vcoCalFreq){
-        if(configMtx->tryLock()){
-            m_vcoCalFreq = freq;
-            m_changeFieldFlags[FIELD_VCO_FREQ_CAL_VALUE] = true;
-            configMtx->unlock();
+/**
+ * @brief Rtty::addCalPoint queue one measured calibration point. The voltage
+ * comes with the measurement, so a dropped setVCOVoltage can't mismatch it,
+ * and points are queued rather than dropped when the worker is busy.
+ */
+void Rtty::addCalPoint(double voltage, double freq){
+    m_queueMtx.lock();
+    m_calPoints.append(QPair<double, double>(voltage, freq));
+    m_queueMtx.unlock();
+}
+
+/**
+ * @brief Rtty::runLinkBenchmark measure field reads per second at every
+ * configured link rate on the next pass of the worker loop. Results come back
+ * through linkBenchmarkResult().
+ */
+void Rtty::runLinkBenchmark(){
+    if(configMtx->tryLock()){
+        m_runLinkBenchmark = true;
+        configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief Rtty::uploadCalCurve send the whole calibration curve to the board
+ * as one table transfer. Skipped by the board side hash check if it already
+ * holds the same curve. Without a curve of at least two points nothing is
+ * sent, so the board keeps its calibration, and calUploadRefused() says why.
+ */
+void Rtty::uploadCalCurve(){
+    if(configMtx->tryLock()){
+        int points = m_calCurve.count();
+        m_uploadCal = m_calCurve.isValid();
+        configMtx->unlock();
+        if(points < 2){
+            emit calUploadRefused(QString("VCO calibration has %1 point%2, need at least 2").arg(points).arg(points == 1 ? "" : "s"));
         }
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief Rtty::setStateFields only poll these fields for radioState(), by
+ * schema name (e.g. "rx_tone"). An empty list polls everything.
+ */
+void Rtty::setStateFields(QStringList names){
+    if(configMtx->tryLock()){
+        m_stateFields = names;
+        m_stateFieldsChanged = true;
+        configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief Rtty::startScan step through freqs (Hz) until a channel shows
+ * sustained mark/space activity. Progress comes back through scanActivity()
+ * and scanLocked().
+ */
+void Rtty::startScan(QList<double> freqs){
+    if(configMtx->tryLock()){
+        m_scanFreqs = freqs;
+        m_scanChanged = true;
+        configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+void Rtty::stopScan(){
+    startScan(QList<double>());
+}
+
+/**
+ * @brief Rtty::setAfcEnabled hold the received tones on the nominal
+ * mark/space frequencies while in RX. Disabling puts the original tuning back.
+ */
+void Rtty::setAfcEnabled(bool enabled){
+    if(configMtx->tryLock()){
+        m_afcRequested = enabled;
+        m_afcChanged = true;
+        configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief Rtty::playWaveform queue time stamped field writes to be played on
+ * the worker against the monotonic clock. Reports timing through
+ * waveformComplete() when done.
+ */
+void Rtty::playWaveform(FieldWaveform waveform){
+    if(configMtx->tryLock()){
+        m_waveforms.append(waveform);
+        configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief Rtty::transmit key up with a PA ramp, send data at the board's RTTY
+ * baud rate and ramp back down
+ */
+void Rtty::transmit(QByteArray data, float paLevelV){
+    double baud = keyingBaudRate();
+    if(baud <= 0.0){
+        return;
+    }
+    playWaveform(FieldScheduler::txKeySequence(data, baud, paLevelV));
+}
+
+/**
+ * @brief Rtty::keyTestPattern key alternating mark and space for at least
+ * seconds, so an analyzer in max hold sees both tones in one sweep
+ */
+void Rtty::keyTestPattern(double seconds){
+    double baud = keyingBaudRate();
+    if(baud <= 0.0 || seconds <= 0.0){
+        return;
+    }
+    int chars = qMax(1, qCeil(seconds*baud/RTTY_BITS_PER_CHAR));
+    QByteArray data;
+    data.reserve(chars);
+    for(int i = 0; i < chars; i++){
+        data.append((char)(i % 2 ? TX_TEST_CHAR_B : TX_TEST_CHAR_A));
     }
+    transmit(data, TX_TEST_PA_LEVEL_V);
 }
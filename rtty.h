@@ -5,8 +5,16 @@
 #include <QMutex>
 #include <QThread>
 #include <QMap>
+#include <QElapsedTimer>
 
 #include "rttyboard.h"
+#include "instrumentation.h"
+#include "reconnect.h"
+#include "channelscanner.h"
+#include "vcocalcurve.h"
+#include "afcloop.h"
+#include "fieldscheduler.h"
+#include "statepublisher.h"
 
 class Rtty : public QThread
 {
@@ -14,6 +22,7 @@ class Rtty : public QThread
     void run() override;
 private:
     RttyBoard* rttyBoard;
+    QString m_comport;
     QMutex* configMtx;
     float m_rxTone;
     QMap<uint8_t, bool> m_changeFieldFlags;
@@ -22,23 +31,76 @@ private:
     double m_baudRate;
     uint8_t m_rxData;
     double m_vcoVoltage;
-    double m_vcoCalFreq;
+    LatencyHistogram* m_loopPeriodHist;
+    LatencyHistogram* m_pollHist;
+    EventCounter* m_droppedUpdates;
+    QList<qint32> m_linkRates;
+    bool m_runLinkBenchmark;
+    bool m_uploadCal;
+    RttyState m_state;
+    StatePublisher<RttyState> m_statePublisher;
+    QStringList m_stateFields;
+    bool m_stateFieldsChanged;
+    void applyStateFields();
+    ChannelScanner m_scanner;
+    bool m_scanning;
+    bool m_scanChanged;
+    QList<double> m_scanFreqs;
+    void scanStep();
+    VcoCalCurve m_calCurve;
+    QMutex m_queueMtx;  // hand-off queues only, never held across board I/O
+    QList<QPair<double, double>> m_calPoints;
+    AfcLoop m_afc;
+    bool m_afcEnabled;
+    bool m_afcChanged;
+    bool m_afcRequested;
+    double m_afcBaseVoltage;
+    double m_afcBaseFreq;
+    double m_afcMarkHz;
+    double m_afcSpaceHz;
+    QElapsedTimer m_afcSettle;
+    void afcStep(float tone);
+    FieldScheduler m_scheduler;
+    QList<FieldWaveform> m_waveforms;
+    bool connectBoard();
+    double keyingBaudRate() const;
 
 public:
-    Rtty(QString comport, QObject *parent = nullptr);
+    Rtty(QString comport, SerialBackend backend = SerialBackend::QT, QObject *parent = nullptr);
     ~Rtty();
+    bool saveCalCurve(QString path);
+    bool loadCalCurve(QString path);
+    quint64 stateSnapshot(RttyState* state) const;
 
 public slots:
-    void setMode(RttyBoard::Mode mode);
-    void setFrequency(double freq);
-    void setBaudRate(double baud);
-    void setVCOVoltage(double voltage);
-    void setVCOCalFreq(double freq);
+    bool setMode(RttyBoard::Mode mode);
+    bool setFrequency(double freq);
+    bool setBaudRate(double baud);
+    bool setVCOVoltage(double voltage);
+    void addCalPoint(double voltage, double freq);
+    void runLinkBenchmark();
+    void uploadCalCurve();
+    void setStateFields(QStringList names);
+    void startScan(QList<double> freqs);
+    void stopScan();
+    void setAfcEnabled(bool enabled);
+    void playWaveform(FieldWaveform waveform);
+    void transmit(QByteArray data, float paLevelV);
+    void keyTestPattern(double seconds);
 
 signals:
     void rxTone(float tone);
     void rxData(uint8_t data);
     void radioState(RttyState state);
+    void connectionStatus(LinkState state, QString detail);
+    void linkBenchmarkResult(qint32 rate, double readsPerSec);
+    void calUploadResult(bool ok, bool skipped, int bytesSent, double elapsedMs);
+    void calUploadRefused(QString reason);
+    void extraFields(QVariantMap values);
+    void scanActivity(double freq, double activity);
+    void scanLocked(double freq);
+    void afcCorrection(double errorHz, double correctionHz);
+    void waveformComplete(int batches, double meanErrorUs, double maxErrorUs);
 };
 
 #endif // RTTY_H
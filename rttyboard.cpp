@@ -1,113 +1,688 @@
 #include "rttyboard.h"
+#include "clock.h"
+#include <QThread>
+#include <QElapsedTimer>
+#include <QDeadlineTimer>
 #include <cstring>
+#include <algorithm>
+#include <functional>
+#include <cstddef>
+#include <QHash>
+
+#define SCHEMA_MAX_PAGES    16
+
+enum class StateMember : int {
+    NONE,
+    INT,
+    FLOAT,
+    BOOL
+};
+
+struct StateBinding {
+    StateMember member;
+    size_t offset;
+};
+
+/*
+ * Where each schema field lands in RttyState, matched by the field's name so
+ * a board that numbers its fields differently still fills in the right
+ * members
+ */
+static const QHash<QString, StateBinding>& stateBindings(){
+    static const QHash<QString, StateBinding> bindings = {
+        {"mode",               {StateMember::INT,   offsetof(RttyState, mode)}},
+        {"freq_mhz",           {StateMember::FLOAT, offsetof(RttyState, freqMHz)}},
+        {"mark_freq",          {StateMember::FLOAT, offsetof(RttyState, markFreq)}},
+        {"space_freq",         {StateMember::FLOAT, offsetof(RttyState, spaceFreq)}},
+        {"baud_rate",          {StateMember::FLOAT, offsetof(RttyState, baudrate)}},
+        {"tx_data",            {StateMember::INT,   offsetof(RttyState, txData)}},
+        {"rx_data_rdy",        {StateMember::BOOL,  offsetof(RttyState, rxDataRdy)}},
+        {"rx_data",            {StateMember::INT,   offsetof(RttyState, rxData)}},
+        {"rx_tone",            {StateMember::FLOAT, offsetof(RttyState, rxTone)}},
+        {"vco_dac_voltage",    {StateMember::FLOAT, offsetof(RttyState, vcoDacVoltage)}},
+        {"vco_freq_cal_value", {StateMember::FLOAT, offsetof(RttyState, vcoFreqCalValue)}},
+        {"pa_dac_voltage",     {StateMember::FLOAT, offsetof(RttyState, paDacVoltage)}},
+    };
+    return bindings;
+}
 
-RttyBoard::RttyBoard(QString& comport, QObject *parent)
+RttyBoard::RttyBoard(QString& comport, SerialBackend backend, QObject *parent)
     : QObject{parent}
 {
-    m_ser = new QSerialPort(comport);
-    m_ser->setBaudRate(QSerialPort::Baud115200);
-    if(!m_ser->isOpen()){
-        m_ser->open(QIODeviceBase::ReadWrite);
-    }
+    m_comport = comport;
+    m_backend = backend;
+    m_ser = nullptr;
+    m_protocol = RttyBoard::LinkProtocol::LEGACY;
+    m_seq = 0;
+    m_linkRate = BOARD_DEFAULT_LINK_RATE;
+    m_schema = builtinSchema();
+
+    m_readFieldsHist = Instrumentation::instance().histogram("board.readFields");
+    m_setFieldsHist = Instrumentation::instance().histogram("board.setFields");
+    m_roundTripHist = Instrumentation::instance().histogram("board.roundTrip");
+    m_crcErrors = Instrumentation::instance().counter("board.crcErrors");
+    m_resyncBytes = Instrumentation::instance().counter("board.resyncBytes");
+    m_staleFrames = Instrumentation::instance().counter("board.staleFrames");
+    m_timeouts = Instrumentation::instance().counter("board.timeouts");
 }
 
 RttyBoard::~RttyBoard(){
-    m_ser->close();
-    delete m_ser;
+    close();
 }
 
-void RttyBoard::updateRttyState(RttyState* state){
-    QList<uint8_t> all_fields;
-    for(uint8_t i = 0; i < NUM_FIELDS; i++){
-        all_fields.append(i);
+/**
+ * @brief RttyBoard::open open the serial port. The transport is created here
+ * rather than in the constructor so it belongs to whichever thread drives the
+ * board. The port opens at the last negotiated link rate, since a board we
+ * lost track of may still be sitting at it; negotiateProtocol() falls back to
+ * BOARD_DEFAULT_LINK_RATE if the board doesn't answer there.
+ * @return true if the port is open
+ */
+bool RttyBoard::open(){
+    if(m_ser == nullptr){
+        m_ser = SerialTransport::create(m_backend, m_comport);
     }
+    if(!m_ser->open(m_linkRate)){
+        return false;
+    }
+    m_decoder.clear();
+    m_protocol = RttyBoard::LinkProtocol::LEGACY;
+    return true;
+}
 
-    auto field_data = readFields(all_fields);
-    uint32_t tmp;
-    for(auto pair : field_data){
-        tmp = pair.second;
-        switch(pair.first){
-        case FIELD_MODE:
-            state->mode = (int)tmp;
-            break;
-        case FIELD_FREQ_MHZ:
-            memcpy(&(state->freqMHz), &tmp, 4);
-            break;
-        case FIELD_MARK_FREQ:
-            memcpy(&(state->markFreq), &tmp, 4);
-            break;
-        case FIELD_SPACE_FREQ:
-            memcpy(&(state->spaceFreq), &tmp, 4);
-            break;
-        case FIELD_BAUD_RATE:
-            memcpy(&(state->baudrate), &tmp, 4);
+void RttyBoard::close(){
+    if(m_ser != nullptr){
+        m_ser->close();
+        delete m_ser;
+        m_ser = nullptr;
+    }
+}
+
+bool RttyBoard::isOpen(){
+    return m_ser != nullptr && m_ser->isOpen();
+}
+
+/**
+ * @brief RttyBoard::linkLost true once the port has gone away underneath us,
+ * e.g. the USB adapter was unplugged
+ */
+bool RttyBoard::linkLost(){
+    return !isOpen() || m_ser->lost();
+}
+
+/**
+ * @brief RttyBoard::testComms send CMD_TEST_COMMS with the current link
+ * protocol and wait for the board to answer
+ * @return true if the board answered
+ */
+bool RttyBoard::testComms(){
+    if(!isOpen()){
+        return false;
+    }
+    QByteArray rpy;
+    return transact(CMD_TEST_COMMS, QByteArray(), &rpy);
+}
+
+/**
+ * @brief RttyBoard::negotiateProtocol offer the framed protocol to the board.
+ * The offer is a legacy CMD_TEST_COMMS carrying the frame version as its one
+ * payload byte. Framed firmware answers with the version it accepts and
+ * switches over; old firmware ignores the payload and answers as before, and
+ * we stay on the legacy format. A framed CMD_TEST_COMMS then confirms the
+ * switch, and firmware that never sees it falls back to legacy on its own.
+ * @return true if the board answered in either protocol
+ */
+bool RttyBoard::negotiateProtocol(){
+    if(!isOpen()){
+        return false;
+    }
+    if(offerProtocol()){
+        return true;
+    }
+    if(m_linkRate == BOARD_DEFAULT_LINK_RATE){
+        return false;
+    }
+
+    // not at the old rate, so the board reset or gave up on it
+    m_linkRate = BOARD_DEFAULT_LINK_RATE;
+    m_ser->setBaudRate(m_linkRate);
+    m_ser->clear();
+    m_decoder.clear();
+    return offerProtocol();
+}
+
+/**
+ * @brief RttyBoard::offerProtocol one round of the protocol offer at the
+ * current link rate
+ * @return true if the board answered in either protocol
+ */
+bool RttyBoard::offerProtocol(){
+    m_protocol = RttyBoard::LinkProtocol::LEGACY;
+
+    QByteArray offer(1, (char)FRAME_VERSION);
+    QByteArray rpy;
+    if(!transact(CMD_TEST_COMMS, offer, &rpy)){
+        return false;
+    }
+    if(rpy.length() < 1 || (uint8_t)rpy[0] != FRAME_VERSION){
+        return true; // legacy firmware
+    }
+
+    m_protocol = RttyBoard::LinkProtocol::FRAMED;
+    m_decoder.clear();
+    if(!testComms()){
+        m_protocol = RttyBoard::LinkProtocol::LEGACY;
+        m_ser->clear();
+        return testComms();
+    }
+    return true;
+}
+
+RttyBoard::LinkProtocol RttyBoard::protocol(){
+    return m_protocol;
+}
+
+/**
+ * @brief RttyBoard::setLinkRate move host and board to a new serial rate.
+ * The board acks CMD_SET_LINK_RATE at the old rate and then switches. If it
+ * doesn't see a good CMD_TEST_COMMS at the new rate within a second it drops
+ * back to BOARD_DEFAULT_LINK_RATE, and so do we.
+ * @param rate baud rate to switch to
+ * @return true if the link works at the new rate
+ */
+bool RttyBoard::setLinkRate(qint32 rate){
+    if(!isOpen()){
+        return false;
+    }
+    if(rate == m_linkRate){
+        return true;
+    }
+
+    QByteArray payload(4, 0x00);
+    memcpy(payload.data(), &rate, 4);
+    QByteArray rpy;
+    if(!transact(CMD_SET_LINK_RATE, payload, &rpy) || rpy.length() < 1 || rpy[0] == 0){
+        return false; // firmware doesn't know the command or won't do this rate
+    }
+
+    m_ser->waitForBytesWritten(BOARD_RPY_TIMEOUT_MS);
+    QThread::msleep(LINK_RATE_SETTLE_MS);
+    m_ser->setBaudRate(rate);
+    m_ser->clear();
+    m_decoder.clear();
+    m_linkRate = rate;
+
+    for(int i = 0; i < LINK_RATE_TEST_TRIES; i++){
+        if(testComms()){
+            return true;
+        }
+    }
+
+    // board reverts by itself once it gives up on the new rate
+    m_linkRate = BOARD_DEFAULT_LINK_RATE;
+    m_ser->setBaudRate(m_linkRate);
+    QThread::msleep(LINK_RATE_FALLBACK_MS);
+    m_ser->clear();
+    m_decoder.clear();
+    return false;
+}
+
+/**
+ * @brief RttyBoard::negotiateLinkRate try rates from fastest to slowest and
+ * keep the first one the board and adapter both manage
+ * @return the rate the link ended up at
+ */
+qint32 RttyBoard::negotiateLinkRate(const QList<qint32>& rates){
+    QList<qint32> sorted = rates;
+    std::sort(sorted.begin(), sorted.end(), std::greater<qint32>());
+    for(auto rate : sorted){
+        if(rate <= m_linkRate){
             break;
-        case FIELD_TX_DATA:
-            memcpy(&(state->txData), &tmp, 4);
+        }
+        if(setLinkRate(rate)){
             break;
-        case FIELD_RX_DATA:
-            memcpy(&(state->rxData), &tmp, 4);
+        }
+    }
+    return m_linkRate;
+}
+
+qint32 RttyBoard::linkRate(){
+    return m_linkRate;
+}
+
+/**
+ * @brief RttyBoard::benchmarkFieldReads read the full state back to back for
+ * durationMs at the current link rate
+ * @return single field reads per second
+ */
+double RttyBoard::benchmarkFieldReads(int durationMs){
+    QList<uint8_t> all_fields = m_schema.ids();
+
+    quint64 reads = 0;
+    QElapsedTimer timer;
+    timer.start();
+    while(timer.elapsed() < durationMs && !interrupted()){
+        reads += readFields(all_fields).length();
+    }
+    return (double)reads * 1000.0 / (double)timer.elapsed();
+}
+
+/**
+ * @brief RttyBoard::benchmarkLinkRates run benchmarkFieldReads at the default
+ * rate and each rate in rates, then return to the fastest working rate
+ * @return rate:reads per second pairs, 0 for rates the link couldn't reach
+ */
+QList<QPair<qint32, double>> RttyBoard::benchmarkLinkRates(const QList<qint32>& rates, int durationMs){
+    QList<QPair<qint32, double>> retval;
+    QList<qint32> all_rates = rates;
+    if(!all_rates.contains(BOARD_DEFAULT_LINK_RATE)){
+        all_rates.prepend(BOARD_DEFAULT_LINK_RATE);
+    }
+    std::sort(all_rates.begin(), all_rates.end());
+
+    qint32 best = BOARD_DEFAULT_LINK_RATE;
+    for(auto rate : all_rates){
+        if(interrupted()){
+            return retval; // the current rate works, leave the link on it
+        }
+        double readsPerSec = 0.0;
+        if(setLinkRate(rate)){
+            readsPerSec = benchmarkFieldReads(durationMs);
+            best = rate;
+        }
+        retval.append(QPair<qint32, double>(rate, readsPerSec));
+    }
+    if(best != m_linkRate){
+        setLinkRate(best);
+    }
+    return retval;
+}
+
+/**
+ * @brief RttyBoard::builtinSchema the fields_enum layout, used for firmware
+ * that doesn't answer CMD_READ_SCHEMA. RttyState is filled by field name,
+ * so a reported schema only has to keep these names for the core fields.
+ */
+FieldSchema RttyBoard::builtinSchema(){
+    FieldSchema schema;
+    schema.add({FIELD_MODE,               FieldType::U32,  "mode",               ""});
+    schema.add({FIELD_FREQ_MHZ,           FieldType::F32,  "freq_mhz",           "MHz"});
+    schema.add({FIELD_MARK_FREQ,          FieldType::F32,  "mark_freq",          "Hz"});
+    schema.add({FIELD_SPACE_FREQ,         FieldType::F32,  "space_freq",         "Hz"});
+    schema.add({FIELD_BAUD_RATE,          FieldType::F32,  "baud_rate",          "baud"});
+    schema.add({FIELD_TX_DATA,            FieldType::U32,  "tx_data",            ""});
+    schema.add({FIELD_RX_DATA_RDY,        FieldType::BOOL, "rx_data_rdy",        ""});
+    schema.add({FIELD_RX_DATA,            FieldType::U32,  "rx_data",            ""});
+    schema.add({FIELD_RX_TONE,            FieldType::F32,  "rx_tone",            "Hz"});
+    schema.add({FIELD_VCO_DAC_VOLTAGE,    FieldType::F32,  "vco_dac_voltage",    "V"});
+    schema.add({FIELD_VCO_FREQ_CAL_VALUE, FieldType::F32,  "vco_freq_cal_value", "Hz"});
+    schema.add({FIELD_PA_DAC_VOLTAGE,     FieldType::F32,  "pa_dac_voltage",     "V"});
+    return schema;
+}
+
+/**
+ * @brief RttyBoard::readSchema ask the board for its field list. Falls back
+ * to the built in schema when the board doesn't know CMD_READ_SCHEMA or
+ * reports no fields at all.
+ * @return true if the board reported its own schema
+ */
+bool RttyBoard::readSchema(){
+    FieldSchema schema;
+    int total = 0;
+    for(int page = 0; page < SCHEMA_MAX_PAGES; page++){
+        QByteArray req(1, (char)schema.count());
+        QByteArray rpy;
+        if(!transact(CMD_READ_SCHEMA, req, &rpy) || !schema.appendPage(rpy, &total) || total == 0){
             break;
-        case FIELD_RX_DATA_RDY:
-            state->rxDataRdy = (bool)tmp;
+        }
+        if(schema.count() >= total){
+            m_schema = schema;
+            m_subscribed.clear();
+            return true;
+        }
+    }
+    m_schema = builtinSchema();
+    m_subscribed.clear();
+    return false;
+}
+
+const FieldSchema& RttyBoard::schema(){
+    return m_schema;
+}
+
+/**
+ * @brief RttyBoard::toBoardFields translate fields numbered as in
+ * fields_enum, the way FieldScheduler builds waveforms, to this board's ids
+ * by name. Fields the board doesn't have are dropped.
+ */
+QList<QPair<uint8_t, uint32_t>> RttyBoard::toBoardFields(const QList<QPair<uint8_t, uint32_t>>& fields) const{
+    static const FieldSchema builtin = builtinSchema();
+    QList<QPair<uint8_t, uint32_t>> retval;
+    for(auto pair : fields){
+        const FieldDesc* desc = builtin.field(pair.first);
+        int id = desc == nullptr ? -1 : fieldId(desc->name);
+        if(id >= 0){
+            retval.append(QPair<uint8_t, uint32_t>((uint8_t)id, pair.second));
+        }
+    }
+    return retval;
+}
+
+/**
+ * @brief RttyBoard::setSubscribedFields limit updateRttyState to these
+ * fields so each poll only moves what somebody actually looks at
+ * @param ids field ids, empty to read every field in the schema
+ */
+void RttyBoard::setSubscribedFields(const QList<uint8_t>& ids){
+    m_subscribed.clear();
+    for(auto id : ids){
+        if(m_schema.field(id) != nullptr){
+            m_subscribed.append(id);
+        }
+    }
+}
+
+/**
+ * @brief RttyBoard::tuneAndSampleTone retune and read the RX tone samples
+ * times. The frequency write and all the tone reads go out in one serial
+ * write so a scan step costs a single link round trip.
+ * @param freq frequency in Hz
+ * @param settle extra reads right after the retune that are dropped, since
+ * the tone detector still reports the old channel for a moment
+ * @return the tone samples that came back, in order
+ */
+QList<float> RttyBoard::tuneAndSampleTone(double freq, int samples, int settle){
+    int freqId = fieldId("freq_mhz");
+    if(!isOpen() || freqId < 0){
+        return QList<float>();
+    }
+    float MHz = (float)freq/1.0e6;
+    QByteArray set_payload(5, 0x00);
+    set_payload[0] = (char)freqId;
+    memcpy(set_payload.data() + 1, &MHz, 4);
+
+    uint8_t seq;
+    return batchToneReads(encodeRequest(CMD_SET_FIELDS, set_payload, &seq), samples, settle);
+}
+
+/**
+ * @brief RttyBoard::sampleTone read the RX tone samples times in one burst
+ */
+QList<float> RttyBoard::sampleTone(int samples){
+    return batchToneReads(QByteArray(), samples, 0);
+}
+
+QList<float> RttyBoard::batchToneReads(QByteArray batch, int samples, int settle){
+    QList<float> retval;
+    int toneId = fieldId("rx_tone");
+    if(!isOpen() || toneId < 0){
+        return retval;
+    }
+    QByteArray read_payload(1, (char)toneId);
+    uint8_t seq;
+    QList<uint8_t> seqs;
+    for(int i = 0; i < settle + samples; i++){
+        batch += encodeRequest(CMD_READ_FIELDS, read_payload, &seq);
+        seqs.append(seq);
+    }
+    m_ser->write(batch);
+
+    for(int i = 0; i < seqs.length(); i++){
+        LatencyTimer timer(m_readFieldsHist);
+        QByteArray rpy;
+        if(!readReply(CMD_READ_FIELDS, seqs[i], &rpy)){
             break;
-        case FIELD_RX_TONE:
-            memcpy(&(state->rxTone), &tmp, 4);
+        }
+        if(i >= settle && rpy.length() >= 5 && (uint8_t)rpy[0] == toneId){
+            float tone;
+            memcpy(&tone, rpy.constData() + 1, 4);
+            retval.append(tone);
+        }
+    }
+    return retval;
+}
+
+/**
+ * @brief RttyBoard::updateRttyState read the subscribed fields and decode
+ * them into state. Fields that aren't subscribed are left untouched.
+ * @param extra if given, receives fields the schema has but RttyState doesn't, by name
+ */
+void RttyBoard::updateRttyState(RttyState* state, QVariantMap* extra){
+    QList<uint8_t> fields = m_subscribed.isEmpty() ? m_schema.ids() : m_subscribed;
+    applyFields(m_schema, readFields(fields), state, extra);
+}
+
+/**
+ * @brief RttyBoard::readRttyFields read just the named fields into state,
+ * whatever is subscribed
+ * @param names schema field names, e.g. "mark_freq"
+ */
+void RttyBoard::readRttyFields(const QStringList& names, RttyState* state){
+    QList<uint8_t> fields;
+    for(const auto& name : names){
+        const FieldDesc* desc = m_schema.field(name);
+        if(desc != nullptr){
+            fields.append(desc->id);
+        }
+    }
+    if(!fields.isEmpty()){
+        applyFields(m_schema, readFields(fields), state);
+    }
+}
+
+/**
+ * @brief RttyBoard::applyFields copy field values read from a board into
+ * state, by schema field name
+ * @param extra collects fields RttyState has no member for, may be nullptr
+ */
+void RttyBoard::applyFields(const FieldSchema& schema, const QList<QPair<uint8_t, uint32_t>>& values,
+                            RttyState* state, QVariantMap* extra){
+    char* base = (char*)state;
+    for(auto pair : values){
+        const FieldDesc* desc = schema.field(pair.first);
+        if(desc == nullptr){
+            continue;
+        }
+        auto binding = stateBindings().constFind(desc->name);
+        StateMember member = binding == stateBindings().constEnd() ? StateMember::NONE : binding->member;
+        void* dst = base + (member == StateMember::NONE ? 0 : binding->offset);
+        switch(member){
+        case StateMember::INT:{
+            int v = (int)FieldSchema::toDouble(desc->type, pair.second);
+            memcpy(dst, &v, sizeof(v));
             break;
-        case FIELD_VCO_DAC_VOLTAGE:
-            memcpy(&(state->vcoDacVoltage), &tmp, 4);
+        }case StateMember::FLOAT:{
+            float v = (float)FieldSchema::toDouble(desc->type, pair.second);
+            memcpy(dst, &v, sizeof(v));
             break;
-        case FIELD_VCO_FREQ_CAL_VALUE:
-            memcpy(&(state->vcoFreqCalValue), &tmp, 4);
+        }case StateMember::BOOL:{
+            bool v = pair.second != 0;
+            memcpy(dst, &v, sizeof(v));
             break;
-        case FIELD_PA_DAC_VOLTAGE:
-            memcpy(&(state->paDacVoltage), &tmp, 4);
+        }case StateMember::NONE:{
+            if(extra != nullptr){
+                extra->insert(desc->name, FieldSchema::toVariant(desc->type, pair.second));
+            }
             break;
+        }
+        }
+    }
+}
+
+/**
+ * @brief RttyBoard::tableInfo size and CRC-32 of the board's active table
+ * @return false if the board doesn't answer CMD_TABLE_INFO
+ */
+bool RttyBoard::tableInfo(uint8_t id, uint32_t* len, uint32_t* crc){
+    QByteArray rpy;
+    if(!transact(CMD_TABLE_INFO, QByteArray(1, (char)id), &rpy) || rpy.length() < 8){
+        return false;
+    }
+    memcpy(len, rpy.constData(), 4);
+    memcpy(crc, rpy.constData() + 4, 4);
+    return true;
+}
+
+/**
+ * @brief RttyBoard::uploadTable make table the board's active table id.
+ * Nothing is sent if the board already holds an identical table. Otherwise
+ * the table is streamed in pipelined chunks, resuming any upload the board
+ * has staged, committed, and read back to verify. An interruption of the
+ * calling thread stops before the commit, leaving the staged part for the
+ * next upload to resume.
+ */
+TableTransferReport RttyBoard::uploadTable(uint8_t id, const QByteArray& table){
+    TableTransferReport report = {false, false, 0, 0, 0.0};
+    QElapsedTimer timer;
+    timer.start();
+    uint32_t len = table.length();
+    uint32_t crc = crc32Ieee((const uint8_t*)table.constData(), table.length());
+
+    uint32_t boardLen, boardCrc;
+    if(!tableInfo(id, &boardLen, &boardCrc)){
+        report.elapsedMs = timer.nsecsElapsed()/1.0e6;
+        return report; // firmware without table support
+    }
+    if(boardLen == len && boardCrc == crc){
+        report.ok = true;
+        report.skipped = true;
+        report.elapsedMs = timer.nsecsElapsed()/1.0e6;
+        return report;
+    }
 
+    QByteArray begin(9, 0x00);
+    begin[0] = id;
+    memcpy(begin.data() + 1, &len, 4);
+    memcpy(begin.data() + 5, &crc, 4);
+    uint32_t offset = 0;
+    int failures = 0;
+    bool synced = false;
+    while(offset < len && failures <= TABLE_MAX_RETRIES && !interrupted()){
+        if(!synced){
+            // (re)start: the board says how much of this table it already has
+            QByteArray rpy;
+            synced = transact(CMD_TABLE_BEGIN, begin, &rpy) && rpy.length() >= 4;
+            if(synced){
+                memcpy(&offset, rpy.constData(), 4);
+                offset = offset > len ? 0 : offset;
+            }
+        }
+        uint32_t before = offset;
+        if(!synced || !writeTableChunks(id, table, &offset, &report.bytesSent)){
+            // an ack went missing, flush and resync
+            synced = false;
+            m_ser->clear();
+            m_decoder.clear();
         }
+        if(offset <= before){
+            failures++;
+            report.retries++;
+        }else{
+            failures = 0;
+        }
+    }
+    if(offset < len){
+        report.elapsedMs = timer.nsecsElapsed()/1.0e6;
+        return report;
     }
 
+    QByteArray rpy;
+    uint32_t committed = 0;
+    if(transact(CMD_TABLE_COMMIT, QByteArray(1, (char)id), &rpy) && rpy.length() >= 5 && rpy[0] != 0){
+        memcpy(&committed, rpy.constData() + 1, 4);
+    }
+    QByteArray readBack;
+    report.ok = committed == crc && readTable(id, len, &readBack) && readBack == table;
+    report.elapsedMs = timer.nsecsElapsed()/1.0e6;
+    return report;
+}
+
+/**
+ * @brief RttyBoard::readTable read the first len bytes of the active table
+ * @return false on a timeout or short reply
+ */
+bool RttyBoard::readTable(uint8_t id, int len, QByteArray* table){
+    table->clear();
+    QByteArray req(6, 0x00);
+    req[0] = id;
+    while(table->length() < len){
+        uint32_t offset = table->length();
+        uint8_t n = (uint8_t)qMin(len - table->length(), TABLE_CHUNK_LEN);
+        memcpy(req.data() + 1, &offset, 4);
+        req[5] = n;
+        QByteArray rpy;
+        if(!transact(CMD_TABLE_READ, req, &rpy) || rpy.length() != n){
+            return false;
+        }
+        table->append(rpy);
+    }
+    return true;
 }
 
 /*************************/
 /* BEGIN PRIVATE METHODS */
 /*************************/
 
+/**
+ * @brief RttyBoard::writeTableChunks send up to TABLE_WINDOW chunks from
+ * offset in one write, then collect the acks
+ * @param offset in: where the board is. out: where it asks to continue,
+ * which goes backwards if a chunk was rejected
+ * @return false if an ack timed out and offset is unknown
+ */
+bool RttyBoard::writeTableChunks(uint8_t id, const QByteArray& table, uint32_t* offset, int* bytesSent){
+    QByteArray batch;
+    QList<uint8_t> seqs;
+    uint32_t pos = *offset;
+    for(int i = 0; i < TABLE_WINDOW && pos < (uint32_t)table.length(); i++){
+        int n = qMin(table.length() - (int)pos, TABLE_CHUNK_LEN);
+        QByteArray chunk(5, 0x00);
+        chunk[0] = id;
+        memcpy(chunk.data() + 1, &pos, 4);
+        chunk.append(table.constData() + pos, n);
+        uint16_t crc = crc16Ccitt((const uint8_t*)chunk.constData(), chunk.length());
+        chunk.append((char)(crc & 0xFF));
+        chunk.append((char)(crc >> 8));
+
+        uint8_t seq;
+        batch += encodeRequest(CMD_TABLE_WRITE, chunk, &seq);
+        seqs.append(seq);
+        pos += n;
+        *bytesSent += n;
+    }
+    m_ser->write(batch);
+
+    for(auto s : seqs){
+        QByteArray rpy;
+        if(!readReply(CMD_TABLE_WRITE, s, &rpy) || rpy.length() < 5){
+            return false;
+        }
+        memcpy(offset, rpy.constData() + 1, 4);
+    }
+    return true;
+}
+
 /**
  * @brief RttyBoard::readFields query each field listed in fields argument
  * @param fields list of field indexes to query
  * @return list of index:value pairs read from the board
  */
 QList<QPair<uint8_t, uint32_t>> RttyBoard::readFields(QList<uint8_t>& fields){
+    LatencyTimer timer(m_readFieldsHist);
     QList<QPair<uint8_t, uint32_t>> retval;
 
-    QByteArray cmd_buf(2 + fields.length(), 0x00);
-
-    cmd_buf[0] = CMD_READ_FIELDS;
-    cmd_buf[1] = fields.length();
-    int i = 2;
+    QByteArray cmd_buf(fields.length(), 0x00);
+    int i = 0;
     for(auto field : fields){
         cmd_buf[i] = field;
         i++;
     }
 
-    m_ser->write(cmd_buf);
-
-    QByteArray rpy_buf(2 + 5*fields.length(), 0x00);
-    char* rpy = rpy_buf.data();
-    m_ser->read(rpy, 2);
-    int len = rpy[1];
-    m_ser->read(rpy + 2, len);
-
-    i = 2;
-    while(i < len + 2){
-        uint32_t data;
-        memcpy(&data, rpy + i + 1, 4);
-        QPair<uint8_t, uint32_t> pair(rpy[i], data);
-        retval.append(pair);
+    QByteArray rpy_buf;
+    if(!transact(CMD_READ_FIELDS, cmd_buf, &rpy_buf)){
+        return retval;
     }
-
-    return retval;
+    return decodeFieldValues(rpy_buf);
 }
 
 /**
@@ -115,23 +690,175 @@ QList<QPair<uint8_t, uint32_t>> RttyBoard::readFields(QList<uint8_t>& fields){
  * @param fields a list of index:value pairs
  */
 void RttyBoard::setFields(QList<QPair<uint8_t, uint32_t>>& fields){
-    QByteArray cmd_buf(2 + 5*fields.length(), 0x00);
-    cmd_buf[0] = CMD_SET_FIELDS;
-    cmd_buf[1] = 5*fields.length();
+    LatencyTimer timer(m_setFieldsHist);
+    transact(CMD_SET_FIELDS, encodeFieldValues(fields), nullptr);
+}
+
+/**
+ * @brief RttyBoard::encodeFieldValues CMD_SET_FIELDS payload: [id][u32 LE]
+ * per field
+ */
+QByteArray RttyBoard::encodeFieldValues(const QList<QPair<uint8_t, uint32_t>>& fields){
+    QByteArray cmd_buf(5*fields.length(), 0x00);
     char* cmd = cmd_buf.data();
 
-    int i = 2;
+    int i = 0;
     for(auto pair: fields){
         cmd[i] = pair.first;
         i++;
         memcpy(cmd + i, &pair.second, 4);
         i += 4;
     }
+    return cmd_buf;
+}
+
+/**
+ * @brief RttyBoard::decodeFieldValues split a CMD_READ_FIELDS reply into
+ * index:value pairs, ignoring a short trailing entry
+ */
+QList<QPair<uint8_t, uint32_t>> RttyBoard::decodeFieldValues(const QByteArray& rpy_buf){
+    QList<QPair<uint8_t, uint32_t>> retval;
+    const char* rpy = rpy_buf.constData();
+    int i = 0;
+    while(i + 5 <= rpy_buf.length()){
+        uint32_t data;
+        memcpy(&data, rpy + i + 1, 4);
+        QPair<uint8_t, uint32_t> pair((uint8_t)rpy[i], data);
+        retval.append(pair);
+        i += 5;
+    }
+    return retval;
+}
 
-    m_ser->write(cmd_buf);
+/**
+ * @brief RttyBoard::transact send one command in the negotiated protocol and
+ * optionally wait for its reply
+ * @param cmd one of commands_enum
+ * @param payload command payload, at most 255 bytes
+ * @param reply payload of the reply, nullptr for commands the board doesn't answer
+ * @return false on timeout or a reply for a different command. Without a
+ * reply, false if the request didn't leave within BOARD_RPY_TIMEOUT_MS.
+ */
+bool RttyBoard::transact(uint8_t cmd, const QByteArray& payload, QByteArray* reply){
+    uint8_t seq;
+    QByteArray request = encodeRequest(cmd, payload, &seq);
+    if(request.isEmpty()){
+        return false;
+    }
+    qint64 sentNs = Clock::system()->nowNs();
+    m_ser->write(request);
+    if(reply == nullptr){
+        // nothing comes back, so make sure it has left before we return
+        return m_ser->waitForBytesWritten(BOARD_RPY_TIMEOUT_MS);
+    }
+    if(!readReply(cmd, seq, reply)){
+        return false;
+    }
+    // request out to last reply byte in, without our own wakeup on top
+    qint64 arrivalNs = m_ser->lastArrivalNs();
+    if(arrivalNs >= sentNs){
+        m_roundTripHist->record(arrivalNs - sentNs);
+    }
+    return true;
+}
 
+/**
+ * @brief RttyBoard::encodeRequest build the bytes for one command in the
+ * negotiated protocol without sending them, so several requests can go out
+ * in a single write
+ * @param seq set to the sequence number the reply will carry
+ */
+QByteArray RttyBoard::encodeRequest(uint8_t cmd, const QByteArray& payload, uint8_t* seq){
+    *seq = m_protocol == RttyBoard::LinkProtocol::FRAMED ? ++m_seq : 0;
+    return encodeRequest(m_protocol, *seq, cmd, payload);
 }
 
+/**
+ * @brief RttyBoard::encodeRequest encode one request in protocol. seq is
+ * ignored for the legacy format.
+ * @return empty if the payload is longer than either format's length byte
+ * can describe
+ */
+QByteArray RttyBoard::encodeRequest(RttyBoard::LinkProtocol protocol, uint8_t seq, uint8_t cmd, const QByteArray& payload){
+    if(payload.length() > FRAME_MAX_PAYLOAD){
+        return QByteArray();
+    }
+    if(protocol == RttyBoard::LinkProtocol::FRAMED){
+        BoardFrame frame;
+        frame.seq = seq;
+        frame.cmd = cmd;
+        frame.payload = payload;
+        return frame.encode();
+    }
+
+    QByteArray cmd_buf(2, 0x00);
+    cmd_buf[0] = cmd;
+    cmd_buf[1] = payload.length();
+    cmd_buf.append(payload);
+    return cmd_buf;
+}
+
+/**
+ * @brief RttyBoard::readReply wait for the reply to a request sent earlier
+ * @return false on timeout or a reply for a different command
+ */
+bool RttyBoard::readReply(uint8_t cmd, uint8_t seq, QByteArray* reply){
+    if(m_protocol == RttyBoard::LinkProtocol::FRAMED){
+        return readFramedReply(cmd, seq, reply);
+    }
+
+    char hdr[2];
+    if(!readExact(hdr, 2, BOARD_RPY_TIMEOUT_MS)){
+        m_timeouts->add();
+        return false;
+    }
+    int len = (uint8_t)hdr[1];
+    reply->resize(len);
+    if(len > 0 && !readExact(reply->data(), len, BOARD_RPY_TIMEOUT_MS)){
+        m_timeouts->add();
+        return false;
+    }
+    return (uint8_t)hdr[0] == cmd;
+}
+
+/**
+ * @brief RttyBoard::readFramedReply feed the decoder until the frame
+ * answering seq turns up. Frames left over from earlier timed out requests
+ * are dropped. BOARD_RPY_TIMEOUT_MS bounds the whole call, so a board
+ * streaming stale frames can't keep it here.
+ */
+bool RttyBoard::readFramedReply(uint8_t cmd, uint8_t seq, QByteArray* reply){
+    quint64 crcErrors = m_decoder.crcErrors();
+    quint64 skipped = m_decoder.skippedBytes();
+    bool found = false;
+    QDeadlineTimer deadline(BOARD_RPY_TIMEOUT_MS);
+
+    forever{
+        BoardFrame frame;
+        while(m_decoder.next(&frame)){
+            if(frame.seq == seq && frame.cmd == cmd){
+                *reply = frame.payload;
+                found = true;
+                break;
+            }
+            m_staleFrames->add();
+        }
+        if(found){
+            break;
+        }
+        if(deadline.hasExpired()
+                || (m_ser->bytesAvailable() == 0 && !m_ser->waitForReadyRead((int)deadline.remainingTime()))){
+            m_timeouts->add();
+            m_decoder.dropPending(); // a bad length byte mustn't stall the next reply too
+            break;
+        }
+        m_decoder.feed(m_ser->readAll());
+    }
+
+    m_crcErrors->add(m_decoder.crcErrors() - crcErrors);
+    m_resyncBytes->add(m_decoder.skippedBytes() - skipped);
+    return found;
+}
 
 void RttyBoard::setField(uint8_t field, uint32_t value){
     QList<QPair<uint8_t, uint32_t>> list;
@@ -140,10 +867,32 @@ void RttyBoard::setField(uint8_t field, uint32_t value){
 }
 
 
+/**
+ * @brief RttyBoard::readExact block until len bytes have been read
+ * @return false if the port went quiet for longer than timeoutMs
+ */
+bool RttyBoard::readExact(char* dst, int len, int timeoutMs){
+    int got = 0;
+    while(got < len){
+        qint64 n = m_ser->read(dst + got, len - got);
+        if(n < 0){
+            return false;
+        }
+        got += n;
+        if(got < len && !m_ser->waitForReadyRead(timeoutMs)){
+            return false;
+        }
+    }
+    return true;
+}
+
 uint32_t RttyBoard::readField(uint8_t field){
     QList<uint8_t> fields;
     fields.append(field);
     auto rpy = readFields(fields);
+    if(rpy.isEmpty()){
+        return 0;
+    }
     return rpy[0].second;
 }
 
@@ -161,49 +910,94 @@ void RttyBoard::setFieldFloat(uint8_t field, float value){
     setField(field, n_value);
 }
 
+/**
+ * @brief RttyBoard::fieldId this board's id for a schema field name
+ * @return -1 if the board has no such field
+ */
+int RttyBoard::fieldId(const QString& name) const{
+    const FieldDesc* desc = m_schema.field(name);
+    return desc == nullptr ? -1 : desc->id;
+}
+
+/*
+ * By name, through the board's schema. Reads of a field the board doesn't
+ * have return 0 and writes to one are dropped.
+ */
+uint32_t RttyBoard::readField(const QString& name){
+    int id = fieldId(name);
+    return id < 0 ? 0 : readField((uint8_t)id);
+}
+
+float RttyBoard::readFieldFloat(const QString& name){
+    int id = fieldId(name);
+    return id < 0 ? 0.0f : readFieldFloat((uint8_t)id);
+}
+
+void RttyBoard::setField(const QString& name, uint32_t value){
+    int id = fieldId(name);
+    if(id >= 0){
+        setField((uint8_t)id, value);
+    }
+}
+
+void RttyBoard::setFieldFloat(const QString& name, float value){
+    int id = fieldId(name);
+    if(id >= 0){
+        setFieldFloat((uint8_t)id, value);
+    }
+}
+
+/**
+ * @brief RttyBoard::interrupted the thread driving the board is being
+ * stopped, so long transfers should give up
+ */
+bool RttyBoard::interrupted(){
+    return QThread::currentThread()->isInterruptionRequested();
+}
+
 /**********************/
 /* BEGIN PUBLIC SLOTS */
 /**********************/
 RttyBoard::Mode RttyBoard::getMode(){
-    return (RttyBoard::Mode)readField((uint8_t)FIELD_MODE);
+    return (RttyBoard::Mode)readField("mode");
 }
 void RttyBoard::setMode(RttyBoard::Mode mode){
     uint32_t n_mode = (uint32_t)mode;
-    setField((uint8_t)FIELD_MODE, n_mode);
+    setField("mode", n_mode);
 }
 
 float RttyBoard::getFrequency(){
-    float MHz = readFieldFloat((uint8_t)FIELD_FREQ_MHZ);
+    float MHz = readFieldFloat("freq_mhz");
     return MHz*1.0e6;
 }
 void RttyBoard::setFrequency(double freq){
     float MHz = (float)freq/1.0e6;
-    setFieldFloat((uint8_t)FIELD_FREQ_MHZ, MHz);
+    setFieldFloat("freq_mhz", MHz);
 }
 
 float RttyBoard::getRttyBaudRate(){
-    return readFieldFloat((uint8_t)FIELD_BAUD_RATE);
+    return readFieldFloat("baud_rate");
 }
 void RttyBoard::setRttyBaudRate(double baud){
-    setFieldFloat((uint8_t)FIELD_BAUD_RATE, (float)baud);
+    setFieldFloat("baud_rate", (float)baud);
 }
 
 void RttyBoard::setVcoVoltage(double voltage){
-    setFieldFloat((uint8_t)FIELD_VCO_DAC_VOLTAGE, (float)voltage);
+    setFieldFloat("vco_dac_voltage", (float)voltage);
 }
 
 void RttyBoard::setVcoCalFreq(double freq){
-    setFieldFloat((uint8_t)FIELD_VCO_FREQ_CAL_VALUE, (float)freq);
+    setFieldFloat("vco_freq_cal_value", (float)freq);
 }
 
 float RttyBoard::getRxTone(){
-    return readFieldFloat((uint8_t)FIELD_RX_TONE);
+    return readFieldFloat("rx_tone");
 }
 
 bool RttyBoard::getRxDataReady(){
-    return (bool)readField((uint8_t)FIELD_RX_DATA_RDY);
+    return (bool)readField("rx_data_rdy");
 }
 
 uint8_t RttyBoard::getRxData(){
-    return (uint8_t)readField((uint8_t)FIELD_RX_DATA);
+    return (uint8_t)readField("rx_data");
 }
@@ -2,16 +2,58 @@
 #define RTTYBOARD_H
 
 #include <QObject>
-#include <QSerialPort>
+#include <QVariantMap>
+#include <QStringList>
+#include <QMetaType>
 #include <inttypes.h>
 
+#include "instrumentation.h"
+#include "boardframe.h"
+#include "fieldschema.h"
+#include "serialtransport.h"
+
+#define BOARD_RPY_TIMEOUT_MS    200
+#define BOARD_DEFAULT_LINK_RATE 115200
+#define LINK_RATE_SETTLE_MS     20
+#define LINK_RATE_TEST_TRIES    3
+#define LINK_RATE_FALLBACK_MS   1000    // board gives up on an unconfirmed rate after this
+
 enum commands_enum {
     CMD_NONE,
     CMD_READ_FIELDS,
     CMD_SET_FIELDS,
-    CMD_TEST_COMMS
+    CMD_TEST_COMMS,
+    CMD_SET_LINK_RATE,
+    CMD_READ_SCHEMA,
+    CMD_TABLE_INFO,
+    CMD_TABLE_BEGIN,
+    CMD_TABLE_WRITE,
+    CMD_TABLE_COMMIT,
+    CMD_TABLE_READ
 };
 
+/*
+ * Table transfer, all integers little endian
+ *
+ *  CMD_TABLE_INFO    [id]                          -> [u32 len][u32 crc32] of the active table
+ *  CMD_TABLE_BEGIN   [id][u32 len][u32 crc32]      -> [u32 offset] to resume from, 0 if the
+ *                                                     staged upload was for a different table
+ *  CMD_TABLE_WRITE   [id][u32 offset][data][crc16] -> [u8 ok][u32 next offset]
+ *  CMD_TABLE_COMMIT  [id]                          -> [u8 ok][u32 crc32] board checked the
+ *                                                     staged table and made it active
+ *  CMD_TABLE_READ    [id][u32 offset][u8 len]      -> data of the active table
+ *
+ * The board only accepts a write at its current staged offset and always
+ * answers with where it wants the next one, so lost or corrupted chunks are
+ * just sent again. The per-chunk crc16 covers legacy links, which have no
+ * frame CRC. Staging survives a dropped link, so an interrupted upload picks
+ * up where it stopped.
+ */
+#define TABLE_VCO_CAL       0
+#define TABLE_CHUNK_LEN     240     // fits a 255 byte payload with its header and crc
+#define TABLE_WINDOW        4       // chunks in flight
+#define TABLE_MAX_RETRIES   3
+
 enum fields_enum {
     FIELD_MODE,
     FIELD_FREQ_MHZ,
@@ -43,8 +85,17 @@ typedef struct rtty_state_struct {
     float vcoFreqCalValue;
     float paDacVoltage;
 }RttyState;
+Q_DECLARE_METATYPE(RttyState)
 
 
+struct TableTransferReport {
+    bool ok;
+    bool skipped;       // board already had this table
+    int bytesSent;
+    int retries;
+    double elapsedMs;
+};
+
 class RttyBoard : public QObject
 {
     Q_OBJECT
@@ -57,23 +108,86 @@ public:
         CALIBRATE_VCO = 3
     };
 
-    RttyBoard(QString& comport, QObject *parent = nullptr);
+    enum class LinkProtocol : int {
+        LEGACY = 0,
+        FRAMED = 1
+    };
+
+    RttyBoard(QString& comport, SerialBackend backend = SerialBackend::QT, QObject *parent = nullptr);
     ~RttyBoard();
+    bool open();
+    void close();
+    bool isOpen();
+    bool linkLost();
+    bool testComms();
+    bool negotiateProtocol();
+    RttyBoard::LinkProtocol protocol();
+    bool setLinkRate(qint32 rate);
+    qint32 negotiateLinkRate(const QList<qint32>& rates);
+    qint32 linkRate();
+    double benchmarkFieldReads(int durationMs);
+    QList<QPair<qint32, double>> benchmarkLinkRates(const QList<qint32>& rates, int durationMs);
     float getFrequency();
     float getRttyBaudRate();
     float getRxTone();
     bool getRxDataReady();
     uint8_t getRxData();
-    void updateRttyState(RttyState* state);
+    bool readSchema();
+    const FieldSchema& schema();
+    QList<QPair<uint8_t, uint32_t>> toBoardFields(const QList<QPair<uint8_t, uint32_t>>& fields) const;
+    void setSubscribedFields(const QList<uint8_t>& ids);
+    void updateRttyState(RttyState* state, QVariantMap* extra = nullptr);
+    void readRttyFields(const QStringList& names, RttyState* state);
+    QList<float> tuneAndSampleTone(double freq, int samples, int settle = 0);
+    QList<float> sampleTone(int samples);
+    void setFields(QList<QPair<uint8_t, uint32_t>>& fields);
+    bool tableInfo(uint8_t id, uint32_t* len, uint32_t* crc);
+    TableTransferReport uploadTable(uint8_t id, const QByteArray& table);
+    bool readTable(uint8_t id, int len, QByteArray* table);
+
+    static FieldSchema builtinSchema();
+    static void applyFields(const FieldSchema& schema, const QList<QPair<uint8_t, uint32_t>>& values,
+                            RttyState* state, QVariantMap* extra = nullptr);
+    static QByteArray encodeFieldValues(const QList<QPair<uint8_t, uint32_t>>& fields);
+    static QList<QPair<uint8_t, uint32_t>> decodeFieldValues(const QByteArray& reply);
+    static QByteArray encodeRequest(RttyBoard::LinkProtocol protocol, uint8_t seq, uint8_t cmd, const QByteArray& payload);
 
 private:
-    QSerialPort* m_ser;
+    QString m_comport;
+    SerialBackend m_backend;
+    SerialTransport* m_ser;
+    LatencyHistogram* m_roundTripHist;
+    LatencyHistogram* m_readFieldsHist;
+    LatencyHistogram* m_setFieldsHist;
+    EventCounter* m_crcErrors;
+    EventCounter* m_resyncBytes;
+    EventCounter* m_staleFrames;
+    EventCounter* m_timeouts;
+    RttyBoard::LinkProtocol m_protocol;
+    uint8_t m_seq;
+    qint32 m_linkRate;
+    FieldSchema m_schema;
+    QList<uint8_t> m_subscribed;
+    FrameDecoder m_decoder;
+    bool transact(uint8_t cmd, const QByteArray& payload, QByteArray* reply);
+    QByteArray encodeRequest(uint8_t cmd, const QByteArray& payload, uint8_t* seq);
+    bool readReply(uint8_t cmd, uint8_t seq, QByteArray* reply);
+    bool offerProtocol();
+    QList<float> batchToneReads(QByteArray batch, int samples, int settle);
+    bool writeTableChunks(uint8_t id, const QByteArray& table, uint32_t* offset, int* bytesSent);
+    bool readFramedReply(uint8_t cmd, uint8_t seq, QByteArray* reply);
     QList<QPair<uint8_t, uint32_t>> readFields(QList<uint8_t>& fields);
-    void setFields(QList<QPair<uint8_t, uint32_t>>& fields);
     void setField(uint8_t field, uint32_t value);
+    bool readExact(char* dst, int len, int timeoutMs);
     uint32_t readField(uint8_t field);
     float readFieldFloat(uint8_t field);
     void setFieldFloat(uint8_t field, float value);
+    int fieldId(const QString& name) const;
+    uint32_t readField(const QString& name);
+    float readFieldFloat(const QString& name);
+    void setField(const QString& name, uint32_t value);
+    void setFieldFloat(const QString& name, float value);
+    static bool interrupted();
 
 public slots:
     RttyBoard::Mode getMode();
@@ -0,0 +1,198 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QThread>
+
+#include "serialtransport.h"
+#include "posixserialtransport.h"
+#include "instrumentation.h"
+#include "clock.h"
+
+#ifdef Q_OS_LINUX
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <termios.h>
+#include <unistd.h>
+#endif
+
+/*
+ * Round trip latency of each serial backend through a loopback.
+ *
+ *   RTTY_SerialBench                     pty pair with an echoing emulator
+ *   RTTY_SerialBench --port ttyUSB0      real adapter with TX jumpered to RX
+ *
+ * "caller" is write to the reply being in the caller's hands. "arrival" is
+ * write to the moment the transport saw the last byte come in.
+ */
+
+#define BENCH_DEFAULT_COUNT     2000
+#define BENCH_DEFAULT_SIZE      8   // a framed single field read
+#define BENCH_DEFAULT_RATE      921600
+#define BENCH_TIMEOUT_MS        200
+
+#ifdef Q_OS_LINUX
+/**
+ * @brief The PtyEcho class is the far end of a pseudo terminal that sends
+ * back whatever it is sent, like a loopback plug
+ */
+class PtyEcho
+{
+public:
+    PtyEcho() {
+        m_master = posix_openpt(O_RDWR | O_NOCTTY);
+        if(m_master >= 0 && grantpt(m_master) == 0 && unlockpt(m_master) == 0){
+            m_slave = QString(ptsname(m_master));
+            struct termios tio;
+            tcgetattr(m_master, &tio);
+            cfmakeraw(&tio);
+            tcsetattr(m_master, TCSANOW, &tio);
+        }
+        m_thread = QThread::create([this](){ echo(); });
+        m_thread->start();
+    }
+
+    ~PtyEcho() {
+        m_thread->requestInterruption();
+        m_thread->wait();
+        delete m_thread;
+        if(m_master >= 0){
+            close(m_master);
+        }
+    }
+
+    QString slavePath() const { return m_slave; }
+
+private:
+    void echo() {
+        char buf[256];
+        while(!QThread::currentThread()->isInterruptionRequested()){
+            struct pollfd pfd = {m_master, POLLIN, 0};
+            if(poll(&pfd, 1, 50) <= 0){
+                continue;
+            }
+            ssize_t n = read(m_master, buf, sizeof(buf));
+            if(n > 0 && write(m_master, buf, n) != n){
+                break;
+            }
+        }
+    }
+
+    int m_master;
+    QString m_slave;
+    QThread* m_thread;
+};
+#endif
+
+static bool runBench(SerialTransport* port, qint32 rate, int count, int size,
+                     LatencyHistogram* caller, LatencyHistogram* arrival){
+    if(!port->open(rate)){
+        return false;
+    }
+    QByteArray request(size, 0x00);
+    QByteArray reply(size, 0x00);
+    for(int i = 0; i < count; i++){
+        request[0] = (char)i;
+        qint64 sentNs = Clock::system()->nowNs();
+        port->write(request);
+
+        int got = 0;
+        while(got < size){
+            qint64 n = port->read(reply.data() + got, size - got);
+            if(n < 0){
+                port->close();
+                return false;
+            }
+            got += n;
+            if(got < size && !port->waitForReadyRead(BENCH_TIMEOUT_MS)){
+                port->close();
+                return false;
+            }
+        }
+        qint64 doneNs = Clock::system()->nowNs();
+        caller->record(doneNs - sentNs);
+        if(port->lastArrivalNs() >= sentNs){
+            arrival->record(port->lastArrivalNs() - sentNs);
+        }
+    }
+    port->close();
+    return true;
+}
+
+static QString row(const QString& name, LatencyHistogram* hist){
+    auto usec = [](qint64 ns){ return QString::number(ns/1000.0, 'f', 1); };
+    return QString("%1 %2 %3 %4 %5\n")
+        .arg(name, -22)
+        .arg(usec(hist->percentileNs(50.0)), 9)
+        .arg(usec(hist->percentileNs(99.0)), 9)
+        .arg(usec(hist->maxNs()), 9)
+        .arg(usec((qint64)hist->meanNs()), 9);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"port", "Adapter with TX looped back to RX; a pty echo if omitted.", "port"});
+    parser.addOption({"rate", "Link rate in baud.", "baud", QString::number(BENCH_DEFAULT_RATE)});
+    parser.addOption({"count", "Round trips per backend.", "n", QString::number(BENCH_DEFAULT_COUNT)});
+    parser.addOption({"size", "Bytes per round trip.", "bytes", QString::number(BENCH_DEFAULT_SIZE)});
+    parser.process(a);
+
+    qint32 rate = parser.value("rate").toInt();
+    int count = parser.value("count").toInt();
+    int size = qMax(1, parser.value("size").toInt());
+    QString port = parser.value("port");
+    QTextStream out(stdout);
+
+#ifdef Q_OS_LINUX
+    PtyEcho* pty = nullptr;
+    if(port.isEmpty()){
+        pty = new PtyEcho();
+        port = pty->slavePath();
+    }
+#endif
+    if(port.isEmpty()){
+        out << "no port given and no pty available\n";
+        return 1;
+    }
+
+    out << QString("%1 at %2 baud, %3 round trips of %4 bytes\n").arg(port).arg(rate).arg(count).arg(size);
+    out << "backend                p50 (us)  p99 (us)  max (us) mean (us)\n";
+    QList<QPair<QString, SerialBackend>> backends = {
+        {"qt", SerialBackend::QT},
+        {"posix", SerialBackend::POSIX},
+    };
+    int failed = 0;
+    for(const auto& backend : backends){
+        if(!SerialTransport::available(backend.second)){
+            continue;
+        }
+        LatencyHistogram caller(backend.first + ".caller");
+        LatencyHistogram arrival(backend.first + ".arrival");
+        SerialTransport* transport = SerialTransport::create(backend.second, port);
+        bool ok = runBench(transport, rate, count, size, &caller, &arrival);
+        if(ok){
+            out << row(backend.first + " caller", &caller);
+            out << row(backend.first + " arrival", &arrival);
+        }else{
+            out << QString("%1 failed after %2 round trips\n").arg(backend.first, -22).arg(caller.count());
+            failed++;
+        }
+#ifdef Q_OS_LINUX
+        if(backend.second == SerialBackend::POSIX){
+            PosixSerialTransport* posix = static_cast<PosixSerialTransport*>(transport);
+            out << QString("  ASYNC_LOW_LATENCY %1\n").arg(posix->lowLatency() ? "on" : "not supported");
+        }
+#endif
+        delete transport;
+        out.flush();
+    }
+
+#ifdef Q_OS_LINUX
+    delete pty;
+#endif
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "serialtransport.h"
+#include "posixserialtransport.h"
+#include "clock.h"
+
+/**
+ * @brief SerialTransport::create make a transport for port. Asking for a
+ * backend this platform doesn't have gets the QSerialPort one.
+ */
+SerialTransport* SerialTransport::create(SerialBackend backend, const QString& port){
+#ifdef Q_OS_LINUX
+    if(backend == SerialBackend::POSIX){
+        return new PosixSerialTransport(port);
+    }
+#else
+    Q_UNUSED(backend);
+#endif
+    return new QtSerialTransport(port);
+}
+
+bool SerialTransport::available(SerialBackend backend){
+#ifdef Q_OS_LINUX
+    Q_UNUSED(backend);
+    return true;
+#else
+    return backend == SerialBackend::QT;
+#endif
+}
+
+/***********************/
+/* QT SERIAL TRANSPORT */
+/***********************/
+
+QtSerialTransport::QtSerialTransport(const QString& port)
+{
+    m_ser = nullptr;
+    m_port = port;
+    m_arrivalNs = 0;
+    m_stamped = false;
+}
+
+QtSerialTransport::~QtSerialTransport(){
+    close();
+}
+
+/**
+ * @brief QtSerialTransport::open the QSerialPort is created here rather than
+ * in the constructor so it belongs to whichever thread drives the board
+ */
+bool QtSerialTransport::open(qint32 rate){
+    if(m_ser == nullptr){
+        m_ser = new QSerialPort(m_port);
+    }
+    m_ser->setBaudRate(rate);
+    if(!m_ser->isOpen()){
+        if(!m_ser->open(QIODeviceBase::ReadWrite)){
+            return false;
+        }
+    }
+    m_ser->clear();
+    return true;
+}
+
+void QtSerialTransport::close(){
+    if(m_ser != nullptr){
+        m_ser->close();
+        delete m_ser;
+        m_ser = nullptr;
+    }
+}
+
+bool QtSerialTransport::isOpen(){
+    return m_ser != nullptr && m_ser->isOpen();
+}
+
+bool QtSerialTransport::lost(){
+    return !isOpen() || m_ser->error() == QSerialPort::ResourceError;
+}
+
+bool QtSerialTransport::setBaudRate(qint32 rate){
+    return m_ser->setBaudRate(rate);
+}
+
+void QtSerialTransport::clear(){
+    m_ser->clear();
+}
+
+qint64 QtSerialTransport::write(const QByteArray& data){
+    return m_ser->write(data);
+}
+
+bool QtSerialTransport::waitForBytesWritten(int timeoutMs){
+    return m_ser->waitForBytesWritten(timeoutMs);
+}
+
+qint64 QtSerialTransport::bytesAvailable(){
+    return m_ser->bytesAvailable();
+}
+
+/**
+ * @brief QtSerialTransport::waitForReadyRead QSerialPort waits for new
+ * bytes even with some buffered, so bytes already there return at once
+ */
+bool QtSerialTransport::waitForReadyRead(int timeoutMs){
+    if(m_ser->bytesAvailable() > 0){
+        return true;
+    }
+    bool ready = m_ser->waitForReadyRead(timeoutMs);
+    if(ready){
+        m_arrivalNs = Clock::system()->nowNs();
+        m_stamped = true;
+    }
+    return ready;
+}
+
+qint64 QtSerialTransport::read(char* dst, qint64 maxLen){
+    qint64 n = m_ser->read(dst, maxLen);
+    if(n > 0){
+        stampRead();
+    }
+    return n;
+}
+
+QByteArray QtSerialTransport::readAll(){
+    QByteArray data = m_ser->readAll();
+    if(!data.isEmpty()){
+        stampRead();
+    }
+    return data;
+}
+
+/**
+ * @brief QtSerialTransport::stampRead bytes that no wait stamped were in the
+ * buffer by now at the latest, which beats keeping an older wait's stamp
+ */
+void QtSerialTransport::stampRead(){
+    if(!m_stamped){
+        m_arrivalNs = Clock::system()->nowNs();
+    }
+    m_stamped = false;
+}
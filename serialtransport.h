@@ -0,0 +1,77 @@
+#ifndef SERIALTRANSPORT_H
+#define SERIALTRANSPORT_H
+
+#include <QByteArray>
+#include <QSerialPort>
+#include <QString>
+
+enum class SerialBackend : int {
+    QT = 0,     // QSerialPort, every platform
+    POSIX = 1   // native termios/epoll backend, Linux only
+};
+
+/**
+ * @brief The SerialTransport class is the byte pipe under RttyBoard. It is
+ * driven from a single thread and only offers the blocking calls the board
+ * protocol needs. Besides the bytes, a transport reports when the last byte
+ * it handed out actually arrived, on Clock::system(), so round trip time
+ * can be told apart from the time the driving thread took to wake up.
+ */
+class SerialTransport
+{
+public:
+    virtual ~SerialTransport() {}
+
+    virtual bool open(qint32 rate) = 0;
+    virtual void close() = 0;
+    virtual bool isOpen() = 0;
+    virtual bool lost() = 0;
+    virtual bool setBaudRate(qint32 rate) = 0;
+    virtual void clear() = 0;
+    virtual qint64 write(const QByteArray& data) = 0;
+    virtual bool waitForBytesWritten(int timeoutMs) = 0;
+    virtual qint64 bytesAvailable() = 0;
+    virtual bool waitForReadyRead(int timeoutMs) = 0;
+    virtual qint64 read(char* dst, qint64 maxLen) = 0;
+    virtual QByteArray readAll() = 0;
+    virtual qint64 lastArrivalNs() = 0;
+
+    static SerialTransport* create(SerialBackend backend, const QString& port);
+    static bool available(SerialBackend backend);
+};
+
+/**
+ * @brief The QtSerialTransport class wraps QSerialPort. Arrival times are
+ * taken when waitForReadyRead() returns, so they include the thread wakeup.
+ * Bytes handed out without a wait in between, e.g. left over in
+ * QSerialPort's buffer, are stamped when they are read.
+ */
+class QtSerialTransport : public SerialTransport
+{
+public:
+    QtSerialTransport(const QString& port);
+    ~QtSerialTransport();
+
+    bool open(qint32 rate) override;
+    void close() override;
+    bool isOpen() override;
+    bool lost() override;
+    bool setBaudRate(qint32 rate) override;
+    void clear() override;
+    qint64 write(const QByteArray& data) override;
+    bool waitForBytesWritten(int timeoutMs) override;
+    qint64 bytesAvailable() override;
+    bool waitForReadyRead(int timeoutMs) override;
+    qint64 read(char* dst, qint64 maxLen) override;
+    QByteArray readAll() override;
+    qint64 lastArrivalNs() override { return m_arrivalNs; }
+
+private:
+    void stampRead();
+    QSerialPort* m_ser;
+    QString m_port;
+    qint64 m_arrivalNs;
+    bool m_stamped;         // m_arrivalNs belongs to bytes not handed out yet
+};
+
+#endif // SERIALTRANSPORT_H
@@ -1,6 +1,7 @@
 #include "siglentspecan.h"
 #include <QDebug>
 #include <string>
+#include <cstdlib>
 
 /********************/
 /* PUBLIC FUNCTIONS */
@@ -20,33 +21,123 @@ std::string qStringToBasic(QString qstr){
 SiglentSpecAn::SiglentSpecAn(QString ipAddr, QObject *parent)
     : QThread{parent}
 {
+    m_resrcStr = QString("TCPIP0::%1::inst0::INSTR").arg(ipAddr);
+    m_defaultRM = VI_NULL;
+    m_instr = VI_NULL;
+    m_failCount = 0;
+    m_doCalibration = false;
+    m_waterfall = false;
+    m_lastTraceUs = 0;
+    m_sweepUs = 0;
+    m_doTxVerify = false;
+    m_calTolerance = EST_DEFAULT_TOL_HZ;
+    m_calToleranceChanged = false;
+
+    m_calEngine = new CalibrationEngine(this, &m_clock);
+    m_calEngine->onSetVcoVoltage = [this](double voltage){ emit setVCOVoltage(voltage); };
+    m_calEngine->onPointComplete = [this](double voltage, double freq){ emit calPointComplete(voltage, freq); };
+    m_calEngine->onPointStats = [this](double freq, double uncertaintyHz, int samples, int rejected){
+        m_calSweeps->add(samples + rejected);
+        emit calPointStats(freq, uncertaintyHz, samples, rejected);
+    };
+    m_calEngine->onComplete = [this](){
+        m_doCalibration = false;
+        emit calibrationComplete();
+    };
+
+    m_configMtx = new QMutex();
+    qRegisterMetaType<QVector<float>>("QVector<float>");
+    qRegisterMetaType<TxVerifyResult>("TxVerifyResult");
+
+    m_queryHist = Instrumentation::instance().histogram("specan.query");
+    m_writeHist = Instrumentation::instance().histogram("specan.write");
+    m_loopPeriodHist = Instrumentation::instance().histogram("specan.loopPeriod");
+    m_droppedUpdates = Instrumentation::instance().counter("specan.droppedUpdates");
+    m_traceHist = Instrumentation::instance().histogram("specan.traceRead");
+    m_calSweeps = Instrumentation::instance().counter("specan.calSweeps");
+    m_txVerifyHist = Instrumentation::instance().histogram("specan.txVerify");
+}
+
+SiglentSpecAn::~SiglentSpecAn(){
+    disconnectInstrument();
+    delete m_calEngine;
+    delete m_configMtx;
+}
+
+/**
+ * @brief SiglentSpecAn::connectInstrument open the VISA session, read the
+ * identity and put the analyzer in its default sweep configuration.
+ * Runs on the analyzer thread so the 2 s VISA timeout never blocks the GUI.
+ * @return true if the analyzer identified itself
+ */
+bool SiglentSpecAn::connectInstrument(){
     m_status = viOpenDefaultRM(&m_defaultRM);
     if(m_status < VI_SUCCESS){
         qDebug() << "Error opening VISA resource manager...";
-        // error
-    }
-    m_resrcStr = QString("TCPIP0::%1::inst0::INSTR").arg(ipAddr);
-    std::string temp;
-    for(int i = 0; i < m_resrcStr.size(); i++){
-        temp.append(1, m_resrcStr[i].toLatin1());
+        m_defaultRM = VI_NULL;
+        return false;
     }
+    std::string temp = qStringToBasic(m_resrcStr);
     qDebug() << "Opening Siglent spectrum analyzer with resource string " << temp.c_str() << "...";
     m_status = viOpen(m_defaultRM, temp.c_str(), VI_NULL, VI_NULL, &m_instr);
     if(m_status < VI_SUCCESS){
         qDebug() << "Error opening Siglent spectrum analyzer with resource string " << temp.c_str() << "...";
         qDebug() << QString("0x%1").arg(m_status, 0, 16);
-        // error
+        m_instr = VI_NULL;
+        disconnectInstrument();
+        return false;
     }
     m_status = viSetAttribute(m_instr, VI_ATTR_TMO_VALUE, 2000);
 
-    m_calState = SiglentSpecAn::State::IDLE;
+    m_failCount = 0;
+    QString idn = getIdentity();
+    if(m_failCount > 0 || idn.isEmpty()){
+        disconnectInstrument();
+        return false;
+    }
+    emit identity(idn);
 
-    m_configMtx = new QMutex();
+    setStartFreq(10.0e6);
+    setStopFreq(40.0e6);
+    setRBW(10000.0);
+    setContPeak(true);
+    return true;
 }
 
-SiglentSpecAn::~SiglentSpecAn(){
-    m_status = viClose(m_instr);
-    m_status = viClose(m_defaultRM);
+void SiglentSpecAn::disconnectInstrument(){
+    if(m_instr != VI_NULL){
+        viClose(m_instr);
+        m_instr = VI_NULL;
+    }
+    if(m_defaultRM != VI_NULL){
+        viClose(m_defaultRM);
+        m_defaultRM = VI_NULL;
+    }
+}
+
+/**
+ * @brief SiglentSpecAn::reconnect (re)open the analyzer, retrying with
+ * backoff until it answers or the thread is asked to stop
+ * @return true once connected
+ */
+bool SiglentSpecAn::reconnect(){
+    ReconnectBackoff backoff;
+    emit connectionStatus(LinkState::CONNECTING, QString("Opening %1").arg(m_resrcStr));
+    forever{
+        disconnectInstrument();
+        if(connectInstrument()){
+            emit connectionStatus(LinkState::CONNECTED, QString("%1 connected").arg(m_resrcStr));
+            return true;
+        }
+
+        int delay = backoff.nextDelayMs();
+        emit connectionStatus(LinkState::RETRYING,
+                              QString("%1 not responding, retry %2 in %3 ms").arg(m_resrcStr).arg(backoff.attempts()).arg(delay));
+        if(!ReconnectBackoff::sleep(delay)){
+            emit connectionStatus(LinkState::DISCONNECTED, QString("%1 closed").arg(m_resrcStr));
+            return false;
+        }
+    }
 }
 
 QString SiglentSpecAn::getIdentity(){
@@ -55,7 +146,7 @@ QString SiglentSpecAn::getIdentity(){
 
 double SiglentSpecAn::getMarkerFreq(){
     QString rpy = query(":CALC:MARKer1:X?\n");
-    return (double)rpy.toFloat();
+    return rpy.toDouble();
 }
 
 double SiglentSpecAn::getSweepTime(){
@@ -63,66 +154,152 @@ double SiglentSpecAn::getSweepTime(){
     return (double)rpy.toFloat();
 }
 
+/**
+ * @brief SiglentSpecAn::getMarkerResolution the marker snaps to a trace
+ * point, so a reading is only good to one point spacing of the current span
+ */
+double SiglentSpecAn::getMarkerResolution(){
+    double span = query(":FREQuency:SPAN?\n").toDouble();
+    return span/(SPECAN_TRACE_POINTS - 1);
+}
+
+/**
+ * @brief SiglentSpecAn::getTrace read the whole of trace 1 in one transfer
+ * @return amplitude of every trace point in dBm
+ */
+QVector<float> SiglentSpecAn::getTrace(){
+    LatencyTimer timer(m_traceHist);
+    QByteArray rpy = queryBulk(":TRACe:DATA? 1\n");
+    QVector<float> trace;
+    trace.reserve(rpy.count(',') + 1);
+
+    const char* p = rpy.constData();
+    char* end;
+    forever{
+        float v = std::strtof(p, &end);
+        if(end == p){
+            break;
+        }
+        trace.append(v);
+        p = end;
+        while(*p == ',' || *p == ' '){
+            p++;
+        }
+    }
+    return trace;
+}
+
 /*******************/
 /* PRIVATE METHODS */
 /*******************/
 void SiglentSpecAn::run(){
+    if(!reconnect()){
+        return;
+    }
+
+    QElapsedTimer loopTimer;
+    loopTimer.start();
     forever{
-        switch(m_calState){
-        case SiglentSpecAn::State::IDLE:{
+        if(isInterruptionRequested()){
+            break;
+        }
+        if(m_failCount >= SPECAN_MAX_FAILURES){
+            if(!reconnect()){
+                return;
+            }
+        }
+
+        m_loopPeriodHist->record(loopTimer.nsecsElapsed());
+        loopTimer.restart();
+
+        if(m_calEngine->state() == CalibrationEngine::State::IDLE){
             // spit out data just for fun
             if(m_configMtx->tryLock()){
+                if(m_doTxVerify){
+                    emit txVerifyResult(runTxVerify());
+                    m_doTxVerify = false;
+                }
                 emit peakFreqMHz(getMarkerFreq()/1.0e6);
+                // one row per sweep; the loop runs much faster than a sweep and
+                // would otherwise repeat the same trace, or a half finished one
+                if(m_waterfall && m_clock.nowUs() - m_lastTraceUs >= m_sweepUs){
+                    QVector<float> trace = getTrace();
+                    if(!trace.isEmpty()){
+                        emit traceData(trace);
+                    }
+                    m_lastTraceUs = m_clock.nowUs();
+                    m_sweepUs = (qint64)(getSweepTime()*1.0e6);
+                }
                 m_configMtx->unlock();
             }
-            break;
-        }case SiglentSpecAn::State::START_CALIBRATION:{
-            setRBW(100000.0);
-            setStartFreq(10.0e6);
-            setStopFreq(40.0e6);
-            setRefLevel(10); // 10 dBm
-            setContPeak(true);
-            QThread::usleep(100000);
-            setMarkerAsCenter(); // peak becomes center of the spectrum
-            setFreqSpan(500000.0);
-            setRBW(300.0);
-
-            m_calState = SiglentSpecAn::State::CALIBRATION;
-            m_vcoSetpt = 0.0;
-            break;
-        }case SiglentSpecAn::State::CALIBRATION:{
-            emit setVCOVoltage(m_vcoSetpt);
-            QThread::usleep(250000); // allow things to settle
-            setMarkerAsCenter(); // center the peak on the screen
-            QThread::usleep(50000);
-
-            double avgFreq = 0.0;
-            int sweepTime = (int)(getSweepTime()*1.0e6);
-            for(int i = 0; i < 10; i++){
-                avgFreq += getMarkerFreq();
-                QThread::usleep(sweepTime + 1000);
-            }
-            emit calPointComplete(avgFreq/10.0);
-
-            m_vcoSetpt += VCO_VOLTAGE_STEP;
-            if(m_vcoSetpt > 3.3){
-                m_calState = SiglentSpecAn::State::STOP_CALIBRATION;
+        }else{
+            // the estimator only changes between points, never under step()
+            if(m_configMtx->tryLock()){
+                if(m_calToleranceChanged){
+                    m_calEngine->estimator().setTolerance(m_calTolerance);
+                    m_calToleranceChanged = false;
+                }
+                m_configMtx->unlock();
             }
-            break;
-        }case SiglentSpecAn::State::STOP_CALIBRATION:{
-            emit calibrationComplete();
-            m_calState = SiglentSpecAn::State::IDLE;
-            break;
+            m_calEngine->step();
         }
-        };
 
+        m_clock.sleepUs(10000);
+    }
+}
+
+/**
+ * @brief SiglentSpecAn::runTxVerify measure mark and space together: narrow
+ * the span around both tones, put trace 1 in max hold, have the board key an
+ * alternating pattern for TXV_SETTLE_SWEEPS sweeps and pick the tone pair out
+ * of the one trace read. The previous span, RBW and trace mode are restored.
+ * Called with m_configMtx held.
+ */
+TxVerifyResult SiglentSpecAn::runTxVerify(){
+    LatencyTimer timer(m_txVerifyHist);
+    double oldStart = query(":FREQuency:STARt?\n").toDouble();
+    double oldStop = query(":FREQuency:STOP?\n").toDouble();
+    double oldRbw = query(":BWIDth:RESolution?\n").toDouble();
+    QString oldMode = query(":TRACe1:MODE?\n").trimmed();
+
+    double start = m_txVerifier.sweepStartHz();
+    double stop = m_txVerifier.sweepStopHz();
+    auto startUnits = getFreqUnits(start);
+    auto stopUnits = getFreqUnits(stop);
+    auto rbwUnits = getFreqUnits(m_txVerifier.sweepRbwHz());
+    sendCommand(QString(":FREQuency:STARt %1 %2\n").arg(startUnits.first, 0, 'f', 6).arg(startUnits.second));
+    sendCommand(QString(":FREQuency:STOP %1 %2\n").arg(stopUnits.first, 0, 'f', 6).arg(stopUnits.second));
+    sendCommand(QString(":BWIDth:RESolution %1 %2\n").arg(rbwUnits.first, 0, 'f', 6).arg(rbwUnits.second));
+    sendCommand(":TRACe1:MODE MAXHold\n");
+
+    double sweepS = getSweepTime();
+    qint64 listenUs = (qint64)(TXV_SETTLE_SWEEPS*sweepS*1.0e6) + TXV_KEY_LEAD_US;
+    emit txKeyRequest((listenUs + TXV_KEY_LEAD_US)/1.0e6);
+    m_clock.sleepUs(listenUs);
+    QVector<float> trace = getTrace();
 
-        QThread::usleep(10000);
+    sendCommand(QString(":TRACe1:MODE %1\n").arg(oldMode.isEmpty() ? "WRITe" : oldMode));
+    if(oldStop > oldStart && oldRbw > 0.0){
+        auto oldStartUnits = getFreqUnits(oldStart);
+        auto oldStopUnits = getFreqUnits(oldStop);
+        auto oldRbwUnits = getFreqUnits(oldRbw);
+        sendCommand(QString(":FREQuency:STARt %1 %2\n").arg(oldStartUnits.first, 0, 'f', 6).arg(oldStartUnits.second));
+        sendCommand(QString(":FREQuency:STOP %1 %2\n").arg(oldStopUnits.first, 0, 'f', 6).arg(oldStopUnits.second));
+        sendCommand(QString(":BWIDth:RESolution %1 %2\n").arg(oldRbwUnits.first, 0, 'f', 6).arg(oldRbwUnits.second));
     }
+    return m_txVerifier.evaluate(trace, start, stop);
 }
+
 QString SiglentSpecAn::query(QString cmd){
+    LatencyTimer timer(m_queryHist);
     sendCommand(cmd);
     m_status = viRead(m_instr, m_buffer, MAX_CNT, &m_retCount);
+    if(m_status < VI_SUCCESS){
+        m_failCount++;
+        m_retCount = 0;
+    }else{
+        m_failCount = 0;
+    }
     QString retval = QString((const char*)m_buffer);
     retval.truncate(m_retCount);
     QString cmd_resp = QString("%1 -> %2").arg(cmd.trimmed(), retval.trimmed());
@@ -131,10 +308,32 @@ QString SiglentSpecAn::query(QString cmd){
     return retval.trimmed();
 }
 
+/**
+ * @brief SiglentSpecAn::queryBulk like query() but keeps reading while the
+ * instrument has more to send, for replies longer than MAX_CNT
+ * @return raw reply, NUL terminated
+ */
+QByteArray SiglentSpecAn::queryBulk(QString cmd){
+    LatencyTimer timer(m_queryHist);
+    sendCommand(cmd);
+    QByteArray retval;
+    do{
+        m_status = viRead(m_instr, m_buffer, MAX_CNT, &m_retCount);
+        if(m_status < VI_SUCCESS){
+            m_failCount++;
+            return QByteArray();
+        }
+        retval.append((const char*)m_buffer, m_retCount);
+    }while(m_status == VI_SUCCESS_MAX_CNT);
+    m_failCount = 0;
+    return retval;
+}
+
 void SiglentSpecAn::sendCommand(QString cmd){
     if(!cmd.endsWith('\n')){
         cmd += '\n';
     }
+    LatencyTimer timer(m_writeHist);
     std::string temp = qStringToBasic(cmd);
     m_status = viWrite(m_instr, (const unsigned char*)temp.c_str(), cmd.length(), &m_retCount);
 }
@@ -165,6 +364,8 @@ void SiglentSpecAn::setRefLevel(int ref){
         QString cmd = QString(":DISPlay:WINDow:TRACe:Y:RLEVel %1 DBM\n").arg(ref);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 
@@ -174,6 +375,8 @@ void SiglentSpecAn::setStartFreq(double start){
         QString cmd = QString(":FREQuency:STARt %1 %2\n").arg(freqUnits.first, 0, 'f', 6).arg(freqUnits.second);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 void SiglentSpecAn::setStopFreq(double stop){
@@ -182,6 +385,8 @@ void SiglentSpecAn::setStopFreq(double stop){
         QString cmd = QString(":FREQuency:STOP %1 %2\n").arg(freqUnits.first, 0, 'f', 6).arg(freqUnits.second);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 void SiglentSpecAn::setCenterFreq(double center){
@@ -190,6 +395,8 @@ void SiglentSpecAn::setCenterFreq(double center){
         QString cmd = QString(":FREQuency:CENTer %1 %2\n").arg(centerUnits.first, 0, 'f', 6).arg(centerUnits.second);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 void SiglentSpecAn::setFreqSpan(double span){
@@ -198,6 +405,8 @@ void SiglentSpecAn::setFreqSpan(double span){
         QString cmd = QString(":FREQuency:SPAN %1 %2\n").arg(spanUnits.first, 0, 'f', 6).arg(spanUnits.second);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 void SiglentSpecAn::setRBW(double rbw){
@@ -206,6 +415,8 @@ void SiglentSpecAn::setRBW(double rbw){
         QString cmd = QString(":BWIDth:RESolution %1 %2\n").arg(freqUnits.first, 0, 'f', 6).arg(freqUnits.second);
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 
@@ -219,6 +430,8 @@ void SiglentSpecAn::setContPeak(bool on_off){
             sendCommand(cmd);
         }
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 
@@ -227,16 +440,62 @@ void SiglentSpecAn::setMarkerAsCenter(){
         QString cmd = QString(":CALCulate:MARKer1:CENTer\n");
         sendCommand(cmd);
         m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
     }
 }
 
 void SiglentSpecAn::startStopCalibration(bool start_stop){
 
     if(!m_doCalibration && start_stop){
-        m_calState = SiglentSpecAn::State::START_CALIBRATION;
+        m_calEngine->start();
     }else if(m_doCalibration && !start_stop){
-        m_calState = SiglentSpecAn::State::STOP_CALIBRATION;
+        m_calEngine->stop();
     }
 
     m_doCalibration = start_stop;
 }
+
+/**
+ * @brief SiglentSpecAn::setWaterfallEnabled read a full trace once per idle
+ * sweep and publish it through traceData(). The sweep time is read back
+ * after each trace, so span or RBW changes are followed.
+ */
+void SiglentSpecAn::setWaterfallEnabled(bool enabled){
+    m_waterfall = enabled;
+}
+
+/**
+ * @brief SiglentSpecAn::setCalTolerance stop measuring a calibration point
+ * once the 95% confidence interval of its frequency is within +/-toleranceHz
+ */
+void SiglentSpecAn::setCalTolerance(double toleranceHz){
+    if(m_configMtx->tryLock()){
+        m_calTolerance = toleranceHz;
+        m_calToleranceChanged = true;
+        m_configMtx->unlock();
+    }else{
+        m_droppedUpdates->add();
+    }
+}
+
+/**
+ * @brief SiglentSpecAn::verifyTx check the transmitter against the tones the
+ * board reports in one sweep. Asks for keying through txKeyRequest() and
+ * answers with txVerifyResult().
+ * @param carrierHz RttyState.freqMHz in Hz
+ * @param markHz RttyState.markFreq
+ * @param spaceHz RttyState.spaceFreq
+ * @param baud RttyState.baudrate
+ * @return false if the request was dropped, no result will follow
+ */
+bool SiglentSpecAn::verifyTx(double carrierHz, double markHz, double spaceHz, double baud){
+    if(m_configMtx->tryLock()){
+        m_txVerifier.setExpected(carrierHz, markHz, spaceHz, baud);
+        m_doTxVerify = true;
+        m_configMtx->unlock();
+        return true;
+    }
+    m_droppedUpdates->add();
+    return false;
+}
@@ -4,40 +4,51 @@
 #include <QObject>
 #include <QThread>
 #include <QMutex>
+#include <QVector>
 #include <visa.h>
+#include <atomic>
+
+#include "instrumentation.h"
+#include "reconnect.h"
+#include "clock.h"
+#include "spectrumanalyzer.h"
+#include "calibrationengine.h"
+#include "txverifier.h"
+
+#define SPECAN_MAX_FAILURES 3
+#define TXV_KEY_LEAD_US     200000  // board picks up the key request and ramps the PA
 
 #define MAX_CNT 1024
-#define VCO_STEPS           512
-#define VCO_VOLTAGE_STEP    (3.3/(VCO_STEPS - 1))
 
-class SiglentSpecAn : public QThread
+class SiglentSpecAn : public QThread, public SpectrumAnalyzer
 {
     Q_OBJECT
     void run() override;
 
-    enum class State : int {
-        IDLE,
-        START_CALIBRATION,
-        CALIBRATION,
-        STOP_CALIBRATION
-    };
 public:
     explicit SiglentSpecAn(QString ipAddr, QObject *parent = nullptr);
     ~SiglentSpecAn();
+    bool connectInstrument();
+    void disconnectInstrument();
     QString getIdentity();
-    double getMarkerFreq();
-    double getSweepTime();
+    double getMarkerFreq() override;
+    double getSweepTime() override;
+    double getMarkerResolution() override;
+    QVector<float> getTrace();
 
 public slots:
-    void setRefLevel(int ref);
-    void setStartFreq(double start);
-    void setStopFreq(double start);
+    void setRefLevel(int ref) override;
+    void setStartFreq(double start) override;
+    void setStopFreq(double start) override;
     void setCenterFreq(double center);
-    void setFreqSpan(double span);
-    void setRBW(double rbw);
-    void setContPeak(bool on_off);
-    void setMarkerAsCenter();
+    void setFreqSpan(double span) override;
+    void setRBW(double rbw) override;
+    void setContPeak(bool on_off) override;
+    void setMarkerAsCenter() override;
     void startStopCalibration(bool start_stop);
+    void setWaterfallEnabled(bool enabled);
+    void setCalTolerance(double toleranceHz);
+    bool verifyTx(double carrierHz, double markHz, double spaceHz, double baud);
 
 private:
     QMutex* m_configMtx;
@@ -47,21 +58,45 @@ private:
     ViUInt32  m_retCount;
     unsigned char m_buffer[MAX_CNT];
     QString m_resrcStr;
+    int m_failCount;
+    bool reconnect();
     void sendCommand(QString cmd);
     QString query(QString cmd);
+    QByteArray queryBulk(QString cmd);
+    std::atomic<bool> m_waterfall;
+    qint64 m_lastTraceUs;
+    qint64 m_sweepUs;
+    LatencyHistogram* m_traceHist;
     QPair<double, QString> getFreqUnits(double freq);
     bool m_doCalibration;
-    SiglentSpecAn::State m_calState;
-    double m_vcoSetpt;
+    SystemClock m_clock;
+    CalibrationEngine* m_calEngine;
+    EventCounter* m_calSweeps;
+    LatencyHistogram* m_queryHist;
+    LatencyHistogram* m_writeHist;
+    LatencyHistogram* m_loopPeriodHist;
+    EventCounter* m_droppedUpdates;
+    TxVerifier m_txVerifier;
+    bool m_doTxVerify;
+    double m_calTolerance;
+    bool m_calToleranceChanged;
+    LatencyHistogram* m_txVerifyHist;
+    TxVerifyResult runTxVerify();
 
 signals:
     void queryCmdResp(QString cmd_resp);
     void peakFreqMHz(double freq);
+    void traceData(QVector<float> trace);
     void peakPower(double pwr);
     void setVCOVoltage(double voltage);
     void setRttyMode(uint8_t mode);
-    void calPointComplete(double freq);
+    void calPointComplete(double voltage, double freq);
+    void calPointStats(double freq, double uncertaintyHz, int samples, int rejected);
     void calibrationComplete();
+    void txKeyRequest(double seconds);
+    void txVerifyResult(TxVerifyResult result);
+    void identity(QString idn);
+    void connectionStatus(LinkState state, QString detail);
 };
 
 #endif // SIGLENTSPECAN_H
@@ -0,0 +1,26 @@
+#ifndef SPECTRUMANALYZER_H
+#define SPECTRUMANALYZER_H
+
+#define SPECAN_TRACE_POINTS 751     // SSA3000X sweep points, markers sit on them
+
+/**
+ * @brief The SpectrumAnalyzer class is the set of analyzer operations the
+ * calibration flow uses, so it can drive either the Siglent or a model.
+ */
+class SpectrumAnalyzer
+{
+public:
+    virtual ~SpectrumAnalyzer() {}
+    virtual double getMarkerFreq() = 0;
+    virtual double getSweepTime() = 0;
+    virtual double getMarkerResolution() = 0;
+    virtual void setRefLevel(int ref) = 0;
+    virtual void setStartFreq(double start) = 0;
+    virtual void setStopFreq(double stop) = 0;
+    virtual void setFreqSpan(double span) = 0;
+    virtual void setRBW(double rbw) = 0;
+    virtual void setContPeak(bool on_off) = 0;
+    virtual void setMarkerAsCenter() = 0;
+};
+
+#endif // SPECTRUMANALYZER_H
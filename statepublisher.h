@@ -0,0 +1,80 @@
+#ifndef STATEPUBLISHER_H
+#define STATEPUBLISHER_H
+
+#include <QtGlobal>
+#include <atomic>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * @brief The StatePublisher class is a single writer seqlock. The writer
+ * never blocks and never allocates; any number of readers on any thread
+ * take consistent snapshots whenever they like and retry if they raced a
+ * publish. The payload is kept as atomic words so a torn read is never a
+ * data race, only a retry.
+ *
+ * The version starts at 0 (nothing published) and goes up by one for every
+ * publish(), so a reader can tell whether anything changed and how many
+ * updates it skipped.
+ */
+template <typename T>
+class StatePublisher
+{
+    static_assert(std::is_trivially_copyable<T>::value, "StatePublisher needs a trivially copyable type");
+
+public:
+    StatePublisher() : m_seq(0) {
+        for(auto& word : m_words){
+            word.store(0, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief StatePublisher::publish store a new snapshot. Only one thread
+     * may publish.
+     */
+    void publish(const T& value){
+        quint32 words[NUM_WORDS] = {};
+        memcpy(words, &value, sizeof(T));
+
+        quint64 seq = m_seq.load(std::memory_order_relaxed);
+        m_seq.store(seq + 1, std::memory_order_relaxed);   // odd: write in progress
+        std::atomic_thread_fence(std::memory_order_release);
+        for(int i = 0; i < NUM_WORDS; i++){
+            m_words[i].store(words[i], std::memory_order_relaxed);
+        }
+        m_seq.store(seq + 2, std::memory_order_release);
+    }
+
+    /**
+     * @brief StatePublisher::read copy out the latest snapshot
+     * @return its version, 0 if nothing has been published yet
+     */
+    quint64 read(T* value) const{
+        quint32 words[NUM_WORDS];
+        quint64 before, after;
+        do{
+            before = m_seq.load(std::memory_order_acquire);
+            while(before & 1){
+                before = m_seq.load(std::memory_order_acquire);
+            }
+            for(int i = 0; i < NUM_WORDS; i++){
+                words[i] = m_words[i].load(std::memory_order_relaxed);
+            }
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = m_seq.load(std::memory_order_relaxed);
+        }while(before != after);
+
+        memcpy(value, words, sizeof(T));
+        return before/2;
+    }
+
+    quint64 version() const { return m_seq.load(std::memory_order_acquire)/2; }
+
+private:
+    static constexpr int NUM_WORDS = (sizeof(T) + sizeof(quint32) - 1)/sizeof(quint32);
+    std::atomic<quint64> m_seq;
+    std::atomic<quint32> m_words[NUM_WORDS];
+};
+
+#endif // STATEPUBLISHER_H
@@ -0,0 +1,186 @@
+#include "telemetryexporter.h"
+#include <QRegularExpression>
+
+#define CONTROL_MAX_LINE    256
+
+TelemetryExporter::TelemetryExporter(QObject *parent)
+    : QObject{parent}
+{
+    m_board = nullptr;
+    m_server = nullptr;
+}
+
+TelemetryExporter::~TelemetryExporter(){
+    stop();
+}
+
+/**
+ * @brief TelemetryExporter::defaultName ring and socket name for a board,
+ * e.g. "rtty_ttyUSB0"
+ */
+QString TelemetryExporter::defaultName(const QString& comport){
+    QString name = comport;
+    name.replace(QRegularExpression("[^A-Za-z0-9]"), "_");
+    return "rtty_" + name;
+}
+
+/**
+ * @brief TelemetryExporter::start export board under name: shared memory
+ * ring "/<name>" and control socket "<name>"
+ * @return false if the control socket couldn't be set up. A missing ring
+ * (no POSIX shared memory) leaves just the control channel running.
+ */
+bool TelemetryExporter::start(Rtty* board, const QString& name){
+    stop();
+    m_board = board;
+
+    m_server = new QLocalServer(this);
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    QLocalServer::removeServer(name); // stale socket from a crash
+    if(!m_server->listen(name)){
+        delete m_server;
+        m_server = nullptr;
+        m_board = nullptr;
+        return false;
+    }
+    connect(m_server, &QLocalServer::newConnection, this, &TelemetryExporter::onConnection);
+
+    if(m_ring.create("/" + name)){
+        // straight from the board thread into the ring, no queued copies
+        m_feeds.append(connect(board, &Rtty::radioState, this, [this](RttyState state){
+            TelemetryState wire = toWire(state);
+            if(m_ringMtx.tryLock()){
+                m_ring.publish(TELEM_STATE, &wire, sizeof(wire));
+                m_ringMtx.unlock();
+            }
+        }, Qt::DirectConnection));
+        m_feeds.append(connect(board, &Rtty::rxTone, this, [this](float tone){
+            if(m_ringMtx.tryLock()){
+                m_ring.publish(TELEM_RX_TONE, &tone, sizeof(tone));
+                m_ringMtx.unlock();
+            }
+        }, Qt::DirectConnection));
+        m_feeds.append(connect(board, &Rtty::rxData, this, [this](uint8_t data){
+            if(m_ringMtx.tryLock()){
+                m_ring.publish(TELEM_RX_DATA, &data, sizeof(data));
+                m_ringMtx.unlock();
+            }
+        }, Qt::DirectConnection));
+    }
+    return true;
+}
+
+void TelemetryExporter::stop(){
+    for(const auto& feed : m_feeds){
+        disconnect(feed);
+    }
+    m_feeds.clear();
+    // a feed already running on the board thread holds the lock until it's done
+    m_ringMtx.lock();
+    m_ring.close();
+    m_ringMtx.unlock();
+
+    if(m_server != nullptr){
+        m_server->close();
+        delete m_server;
+        m_server = nullptr;
+    }
+    m_board = nullptr;
+}
+
+QString TelemetryExporter::serverName() const{
+    return m_server == nullptr ? QString() : m_server->fullServerName();
+}
+
+/*******************/
+/* PRIVATE METHODS */
+/*******************/
+
+TelemetryState TelemetryExporter::toWire(const RttyState& state){
+    TelemetryState wire;
+    wire.mode = state.mode;
+    wire.freqMHz = state.freqMHz;
+    wire.markFreq = state.markFreq;
+    wire.spaceFreq = state.spaceFreq;
+    wire.baudrate = state.baudrate;
+    wire.txData = state.txData;
+    wire.rxData = state.rxData;
+    wire.rxDataRdy = state.rxDataRdy ? 1 : 0;
+    wire.rxTone = state.rxTone;
+    wire.vcoDacVoltage = state.vcoDacVoltage;
+    wire.vcoFreqCalValue = state.vcoFreqCalValue;
+    wire.paDacVoltage = state.paDacVoltage;
+    return wire;
+}
+
+void TelemetryExporter::onConnection(){
+    while(m_server->hasPendingConnections()){
+        QLocalSocket* client = m_server->nextPendingConnection();
+        connect(client, &QLocalSocket::readyRead, this, [this, client](){ onCommand(client); });
+        connect(client, &QLocalSocket::disconnected, client, &QObject::deleteLater);
+    }
+}
+
+void TelemetryExporter::onCommand(QLocalSocket* client){
+    while(client->canReadLine()){
+        QByteArray line = client->readLine(CONTROL_MAX_LINE).trimmed();
+        if(!line.isEmpty()){
+            client->write(execute(line) + "\n");
+        }
+    }
+    if(client->bytesAvailable() > CONTROL_MAX_LINE){
+        client->write("ERR line too long\n");
+        client->disconnectFromServer();
+    }
+}
+
+/**
+ * @brief TelemetryExporter::execute run one control command against the
+ * board. The Rtty setters only flag the change for the board thread, so
+ * nothing here blocks; a change they had to drop is answered "ERR busy" for
+ * the client to retry.
+ * @return the reply line
+ */
+QByteArray TelemetryExporter::execute(const QByteArray& line){
+    QList<QByteArray> args = line.simplified().split(' ');
+    QByteArray cmd = args[0];
+    if(m_board == nullptr){
+        return "ERR no board";
+    }
+    if(cmd == "ring"){
+        return m_ring.isOpen() ? "OK " + m_ring.name().toUtf8() : QByteArray("ERR no ring");
+    }
+    if(args.length() != 2){
+        return "ERR usage: " + cmd + " <value>";
+    }
+
+    if(cmd == "setMode"){
+        static const QMap<QByteArray, RttyBoard::Mode> modes = {
+            {"IDLE", RttyBoard::Mode::IDLE},
+            {"RX", RttyBoard::Mode::RX},
+            {"TX", RttyBoard::Mode::TX},
+            {"CALIBRATE_VCO", RttyBoard::Mode::CALIBRATE_VCO},
+        };
+        if(!modes.contains(args[1].toUpper())){
+            return "ERR unknown mode";
+        }
+        return m_board->setMode(modes[args[1].toUpper()]) ? "OK" : "ERR busy";
+    }
+
+    bool ok = false;
+    double value = args[1].toDouble(&ok);
+    if(!ok){
+        return "ERR bad number";
+    }
+    bool accepted;
+    if(cmd == "setFrequency"){
+        accepted = m_board->setFrequency(value);
+    }else if(cmd == "setBaudRate"){
+        accepted = m_board->setBaudRate(value);
+    }else if(cmd == "setVcoVoltage"){
+        accepted = m_board->setVCOVoltage(value);
+    }else{
+        return "ERR unknown command";
+    }
+    return accepted ? "OK" : "ERR busy";
+}
@@ -0,0 +1,53 @@
+#ifndef TELEMETRYEXPORTER_H
+#define TELEMETRYEXPORTER_H
+
+#include <QObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QMutex>
+
+#include "rtty.h"
+#include "telemetryring.h"
+
+/**
+ * @brief The TelemetryExporter class makes one board visible to other local
+ * processes. State snapshots, RX tones and RX bytes go into a shared memory
+ * TelemetryRing, written straight from the board thread through direct
+ * connections so nothing is queued and nothing waits. A local socket takes
+ * line based commands:
+ *
+ *   setFrequency <Hz>          setBaudRate <baud>
+ *   setMode IDLE|RX|TX|CALIBRATE_VCO
+ *   setVcoVoltage <V>          ring     (shm name of the telemetry ring)
+ *
+ * and answers each with "OK" or "ERR <reason>". "ERR busy" means the board
+ * thread held its config and the change was dropped; send it again.
+ */
+class TelemetryExporter : public QObject
+{
+    Q_OBJECT
+public:
+    explicit TelemetryExporter(QObject *parent = nullptr);
+    ~TelemetryExporter();
+
+    bool start(Rtty* board, const QString& name);
+    void stop();
+    QString ringName() const { return m_ring.isOpen() ? m_ring.name() : QString(); }
+    QString serverName() const;
+
+    static QString defaultName(const QString& comport);
+
+private:
+    void onConnection();
+    void onCommand(QLocalSocket* client);
+    QByteArray execute(const QByteArray& line);
+    static TelemetryState toWire(const RttyState& state);
+
+    Rtty* m_board;
+    TelemetryRing m_ring;
+    QMutex m_ringMtx;
+    QLocalServer* m_server;
+    QList<QMetaObject::Connection> m_feeds;
+};
+
+#endif // TELEMETRYEXPORTER_H
@@ -0,0 +1,205 @@
+#include "telemetryring.h"
+#include "clock.h"
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+TelemetryRing::TelemetryRing()
+{
+    m_owner = false;
+    m_size = 0;
+    m_capacity = 0;
+    m_header = nullptr;
+    m_records = nullptr;
+    m_next = 0;
+}
+
+TelemetryRing::~TelemetryRing(){
+    close();
+}
+
+/**
+ * @brief TelemetryRing::create make the shared memory segment and become
+ * its writer. A segment left behind by a crashed writer is replaced.
+ * @param name shm name, e.g. "/rtty_ttyUSB0"
+ * @param capacity records, rounded up to a power of two
+ * @return false where POSIX shared memory isn't available
+ */
+bool TelemetryRing::create(const QString& name, uint32_t capacity){
+#ifdef Q_OS_UNIX
+    close();
+    uint32_t cap = 1;
+    while(cap < capacity){
+        cap <<= 1;
+    }
+    QByteArray shmName = name.toLocal8Bit();
+    shm_unlink(shmName.constData());
+    int fd = shm_open(shmName.constData(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if(fd < 0){
+        return false;
+    }
+    size_t size = sizeof(TelemetryHeader) + (size_t)cap*sizeof(TelemetryRecord);
+    if(ftruncate(fd, (off_t)size) != 0){
+        ::close(fd);
+        shm_unlink(shmName.constData());
+        return false;
+    }
+    void* mem = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mem == MAP_FAILED){
+        shm_unlink(shmName.constData());
+        return false;
+    }
+
+    // ftruncate zero fills, so every slot starts with seq 0 (never written)
+    m_header = (TelemetryHeader*)mem;
+    m_records = (TelemetryRecord*)((char*)mem + sizeof(TelemetryHeader));
+    m_header->version = TELEM_VERSION;
+    m_header->headerSize = TELEM_HEADER_SIZE;
+    m_header->recordSize = TELEM_RECORD_SIZE;
+    m_header->capacity = cap;
+    m_header->writerPid = getpid();
+    m_header->head.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_header->magic = TELEM_MAGIC; // readers check this last
+
+    m_name = name;
+    m_owner = true;
+    m_size = size;
+    m_capacity = cap;
+    m_next = 0;
+    return true;
+#else
+    Q_UNUSED(name);
+    Q_UNUSED(capacity);
+    return false;
+#endif
+}
+
+/**
+ * @brief TelemetryRing::attach map an existing ring read only
+ * @return false if there is no ring by that name, it's a layout we don't
+ * know, or its capacity isn't a power of two that fits the segment
+ */
+bool TelemetryRing::attach(const QString& name){
+#ifdef Q_OS_UNIX
+    close();
+    int fd = shm_open(name.toLocal8Bit().constData(), O_RDONLY, 0);
+    if(fd < 0){
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(TelemetryHeader)){
+        ::close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* mem = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(mem == MAP_FAILED){
+        return false;
+    }
+
+    TelemetryHeader* header = (TelemetryHeader*)mem;
+    bool valid = header->magic == TELEM_MAGIC;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint32_t cap = header->capacity;
+    // slots are picked with index & (capacity - 1)
+    valid = valid && header->version == TELEM_VERSION
+            && header->headerSize == TELEM_HEADER_SIZE
+            && header->recordSize == TELEM_RECORD_SIZE
+            && cap != 0 && (cap & (cap - 1)) == 0
+            && size >= sizeof(TelemetryHeader) + (size_t)cap*sizeof(TelemetryRecord);
+    if(!valid){
+        munmap(mem, size);
+        return false;
+    }
+    m_header = header;
+    m_records = (TelemetryRecord*)((char*)mem + sizeof(TelemetryHeader));
+    m_name = name;
+    m_owner = false;
+    m_size = size;
+    m_capacity = cap;
+    return true;
+#else
+    Q_UNUSED(name);
+    return false;
+#endif
+}
+
+void TelemetryRing::close(){
+#ifdef Q_OS_UNIX
+    if(m_header != nullptr){
+        munmap(m_header, m_size);
+        if(m_owner){
+            shm_unlink(m_name.toLocal8Bit().constData());
+        }
+    }
+#endif
+    m_header = nullptr;
+    m_records = nullptr;
+    m_owner = false;
+    m_size = 0;
+    m_capacity = 0;
+}
+
+/**
+ * @brief TelemetryRing::publish append one record, overwriting the oldest.
+ * Writer only; payloads longer than TELEM_PAYLOAD_MAX are cut short.
+ */
+void TelemetryRing::publish(uint16_t type, const void* data, int length){
+    if(m_header == nullptr || !m_owner){
+        return;
+    }
+    uint64_t i = m_next++;
+    TelemetryRecord* rec = &m_records[i & (m_capacity - 1)];
+    length = qBound(0, length, TELEM_PAYLOAD_MAX);
+
+    rec->seq.store(2*i + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    rec->timestampNs = Clock::system()->nowNs();
+    rec->type = type;
+    rec->length = (uint16_t)length;
+    memcpy(rec->payload, data, length);
+    rec->seq.store(2*i + 2, std::memory_order_release);
+    m_header->head.store(i + 1, std::memory_order_release);
+}
+
+uint64_t TelemetryRing::head() const{
+    return m_header == nullptr ? 0 : m_header->head.load(std::memory_order_acquire);
+}
+
+uint32_t TelemetryRing::capacity() const{
+    return m_capacity;
+}
+
+/**
+ * @brief TelemetryRing::read copy out record index
+ * @return false if it hasn't been written yet, was overwritten, or was
+ * being written while we copied it
+ */
+bool TelemetryRing::read(uint64_t index, TelemetryRecord* record) const{
+    if(m_header == nullptr){
+        return false;
+    }
+    const TelemetryRecord* rec = &m_records[index & (m_capacity - 1)];
+    uint64_t expect = 2*index + 2;
+    if(rec->seq.load(std::memory_order_acquire) != expect){
+        return false;
+    }
+    record->timestampNs = rec->timestampNs;
+    record->type = rec->type;
+    record->length = qMin(rec->length, (uint16_t)TELEM_PAYLOAD_MAX);
+    memcpy(record->payload, rec->payload, record->length);
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if(rec->seq.load(std::memory_order_relaxed) != expect){
+        return false;
+    }
+    record->seq.store(expect, std::memory_order_relaxed);
+    return true;
+}
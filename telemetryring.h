@@ -0,0 +1,119 @@
+#ifndef TELEMETRYRING_H
+#define TELEMETRYRING_H
+
+#include <QString>
+#include <QtGlobal>
+#include <atomic>
+#include <inttypes.h>
+
+/*
+ * Telemetry ring, POSIX shared memory, native endian
+ *
+ *  +--------------------+----------+----------+-----+----------+
+ *  | TelemetryHeader    | record 0 | record 1 | ... | record N |
+ *  +--------------------+----------+----------+-----+----------+
+ *
+ * One writer, any number of readers, nobody waits on anybody. Record i
+ * lives in slot i % capacity. The writer sets its seq to 2i+1, fills it in,
+ * then sets seq to 2i+2; head is the number of records published. A reader
+ * keeps its own index, copies the slot and checks that seq read 2i+2 both
+ * before and after the copy. If the writer has lapped it, the reader skips
+ * ahead to head - capacity and counts the records it lost.
+ *
+ * Timestamps are CLOCK_MONOTONIC nanoseconds.
+ */
+#define TELEM_MAGIC         0x59545452  // "RTTY"
+#define TELEM_VERSION       2
+#define TELEM_HEADER_SIZE   128
+#define TELEM_RECORD_SIZE   128
+#define TELEM_CAPACITY      4096        // records, power of two
+#define TELEM_PAYLOAD_MAX   (TELEM_RECORD_SIZE - 24)
+
+enum telemetry_type_enum {
+    TELEM_NONE,
+    TELEM_STATE,        // TelemetryState
+    TELEM_RX_TONE,      // float, Hz
+    TELEM_RX_DATA       // uint8_t
+};
+
+struct TelemetryHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t headerSize;
+    uint32_t recordSize;
+    uint32_t capacity;
+    int64_t writerPid;
+    std::atomic<uint64_t> head;
+    uint8_t reserved[TELEM_HEADER_SIZE - 32];
+};
+
+struct TelemetryRecord {
+    std::atomic<uint64_t> seq;
+    int64_t timestampNs;
+    uint16_t type;
+    uint16_t length;
+    uint32_t reserved;
+    uint8_t payload[TELEM_PAYLOAD_MAX];
+};
+
+/*
+ * TELEM_STATE payload, the board's RttyState in a fixed packed layout so a
+ * reader needs neither the board headers nor the writer's compiler padding
+ */
+#pragma pack(push, 1)
+struct TelemetryState {
+    int32_t mode;
+    float freqMHz;
+    float markFreq;
+    float spaceFreq;
+    float baudrate;
+    int32_t txData;
+    int32_t rxData;
+    uint8_t rxDataRdy;
+    float rxTone;
+    float vcoDacVoltage;
+    float vcoFreqCalValue;
+    float paDacVoltage;
+};
+#pragma pack(pop)
+
+static_assert(sizeof(TelemetryHeader) == TELEM_HEADER_SIZE, "telemetry header layout");
+static_assert(sizeof(TelemetryRecord) == TELEM_RECORD_SIZE, "telemetry record layout");
+static_assert(sizeof(TelemetryState) <= TELEM_PAYLOAD_MAX, "telemetry state fits a record");
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "shared memory needs lock free 64 bit atomics");
+
+/**
+ * @brief The TelemetryRing class is either end of the shared memory ring.
+ * create() makes and owns the segment and is the only one that may
+ * publish(); attach() maps an existing one for reading. Publishing is a
+ * memcpy and three stores, so it is safe to call from the board thread.
+ */
+class TelemetryRing
+{
+public:
+    TelemetryRing();
+    ~TelemetryRing();
+
+    bool create(const QString& name, uint32_t capacity = TELEM_CAPACITY);
+    bool attach(const QString& name);
+    void close();
+    bool isOpen() const { return m_header != nullptr; }
+    QString name() const { return m_name; }
+
+    void publish(uint16_t type, const void* data, int length);
+
+    uint64_t head() const;
+    uint32_t capacity() const;
+    bool read(uint64_t index, TelemetryRecord* record) const;
+
+private:
+    QString m_name;
+    bool m_owner;
+    size_t m_size;
+    TelemetryHeader* m_header;
+    TelemetryRecord* m_records;
+    uint32_t m_capacity;    // checked once, the header is writable by another process
+    uint64_t m_next;
+};
+
+#endif // TELEMETRYRING_H
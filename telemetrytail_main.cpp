@@ -0,0 +1,107 @@
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QTextStream>
+#include <QThread>
+#include <QRegularExpression>
+#include <cstring>
+
+#include "telemetryring.h"
+
+/*
+ * Follow a board's telemetry ring from another process, the way a logger
+ * or dashboard would.
+ *
+ *   RTTY_TelemetryTail --port ttyUSB0      ring published for that board
+ *   RTTY_TelemetryTail --ring /rtty_x      ring by shm name
+ *
+ * Starts at the newest record and prints each one as it lands. Records the
+ * writer overwrote before we got to them are reported as lost.
+ */
+
+#define TAIL_IDLE_SLEEP_US      500
+
+static QString describe(const TelemetryRecord& rec){
+    switch(rec.type){
+    case TELEM_STATE: {
+        TelemetryState state;
+        if((size_t)rec.length < sizeof(state)){
+            break;
+        }
+        memcpy(&state, rec.payload, sizeof(state));
+        return QString("state mode=%1 freq=%2MHz mark=%3Hz space=%4Hz baud=%5")
+            .arg(state.mode).arg(state.freqMHz, 0, 'f', 4)
+            .arg(state.markFreq, 0, 'f', 1).arg(state.spaceFreq, 0, 'f', 1)
+            .arg(state.baudrate, 0, 'f', 2);
+    }
+    case TELEM_RX_TONE: {
+        float tone;
+        if((size_t)rec.length < sizeof(tone)){
+            break;
+        }
+        memcpy(&tone, rec.payload, sizeof(tone));
+        return QString("tone %1 Hz").arg(tone, 0, 'f', 1);
+    }
+    case TELEM_RX_DATA:
+        if(rec.length < 1){
+            break;
+        }
+        return QString("data 0x%1").arg((uint)rec.payload[0], 2, 16, QChar('0'));
+    default:
+        break;
+    }
+    return QString("type %1, %2 bytes").arg(rec.type).arg(rec.length);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addOption({"port", "Comport of the exporting board.", "port"});
+    parser.addOption({"ring", "Shared memory name of the ring.", "name"});
+    parser.process(a);
+
+    QString name = parser.value("ring");
+    if(name.isEmpty()){
+        QString port = parser.value("port");
+        name = "/rtty_" + QString(port).replace(QRegularExpression("[^A-Za-z0-9]"), "_");
+    }
+
+    QTextStream out(stdout);
+    TelemetryRing ring;
+    if(!ring.attach(name)){
+        out << "no telemetry ring " << name << "\n";
+        return 1;
+    }
+
+    uint64_t next = ring.head();
+    uint64_t lost = 0;
+    TelemetryRecord rec;
+    forever {
+        uint64_t head = ring.head();
+        if(next == head){
+            QThread::usleep(TAIL_IDLE_SLEEP_US);
+            continue;
+        }
+        if(head - next > ring.capacity()){
+            lost += head - next - ring.capacity();
+            next = head - ring.capacity();
+        }
+        if(!ring.read(next, &rec)){
+            // lapped mid copy, the slot now holds a newer record
+            lost++;
+            next++;
+            continue;
+        }
+        out << QString::number(rec.timestampNs/1e9, 'f', 6) << " " << describe(rec);
+        if(lost > 0){
+            out << " (" << lost << " lost)";
+            lost = 0;
+        }
+        out << "\n";
+        out.flush();
+        next++;
+    }
+    return 0;
+}
@@ -0,0 +1,166 @@
+#include "txverifier.h"
+#include <QtGlobal>
+#include <QtMath>
+#include <algorithm>
+#include <cmath>
+
+TxVerifier::TxVerifier()
+{
+    m_carrierHz = 0.0;
+    m_markHz = 0.0;
+    m_spaceHz = 0.0;
+    m_baud = 0.0;
+    m_toleranceHz = TXV_TOLERANCE_HZ;
+}
+
+/**
+ * @brief TxVerifier::setExpected what the board reports it is sending
+ * @param carrierHz RttyState.freqMHz in Hz
+ * @param markHz RttyState.markFreq
+ * @param spaceHz RttyState.spaceFreq
+ * @param baud RttyState.baudrate, the keying rate during the sweep
+ */
+void TxVerifier::setExpected(double carrierHz, double markHz, double spaceHz, double baud){
+    m_carrierHz = carrierHz;
+    m_markHz = markHz;
+    m_spaceHz = spaceHz;
+    m_baud = baud;
+}
+
+double TxVerifier::expectedMarkHz() const{
+    return m_carrierHz + TXV_TONE_SENSE*m_markHz;
+}
+
+double TxVerifier::expectedSpaceHz() const{
+    return m_carrierHz + TXV_TONE_SENSE*m_spaceHz;
+}
+
+double TxVerifier::expectedShiftHz() const{
+    return qAbs(m_spaceHz - m_markHz);
+}
+
+/**
+ * @brief TxVerifier::sweepStartHz span centred between the two tones, wide
+ * enough that neither sits near the edge
+ */
+double TxVerifier::sweepStartHz() const{
+    double span = qMax(TXV_SPAN_SHIFTS*expectedShiftHz(), TXV_MIN_SPAN_HZ);
+    return 0.5*(expectedMarkHz() + expectedSpaceHz()) - 0.5*span;
+}
+
+double TxVerifier::sweepStopHz() const{
+    double span = qMax(TXV_SPAN_SHIFTS*expectedShiftHz(), TXV_MIN_SPAN_HZ);
+    return 0.5*(expectedMarkHz() + expectedSpaceHz()) + 0.5*span;
+}
+
+/**
+ * @brief TxVerifier::sweepRbwHz widest RBW that still resolves the tones and
+ * smooths out the keying, on the analyzer's 1-3-10 steps
+ */
+double TxVerifier::sweepRbwHz() const{
+    double rbw = expectedShiftHz()/TXV_RBW_DIV;
+    if(m_baud > 0.0){
+        rbw = qMin(rbw, m_baud/TXV_RBW_BITS);
+    }
+    if(rbw <= TXV_MIN_RBW_HZ){
+        return TXV_MIN_RBW_HZ;
+    }
+    double decade = qPow(10.0, qFloor(std::log10(rbw)));
+    return rbw >= 3.0*decade ? 3.0*decade : decade;
+}
+
+/**
+ * @brief TxVerifier::evaluate find the tone pair in a trace and compare it
+ * with the expected tones. The lower tone is mark if mark is expected lower.
+ */
+TxVerifyResult TxVerifier::evaluate(const QVector<float>& trace, double startHz, double stopHz) const{
+    TxVerifyResult result = {};
+    TonePair pair = findTonePair(trace, startHz, stopHz, TXV_MIN_SEPARATION*expectedShiftHz());
+    if(!pair.valid){
+        return result;
+    }
+    result.found = true;
+
+    bool markLow = expectedMarkHz() <= expectedSpaceHz();
+    result.markHz = markLow ? pair.lowHz : pair.highHz;
+    result.spaceHz = markLow ? pair.highHz : pair.lowHz;
+    float markDbm = markLow ? pair.lowDbm : pair.highDbm;
+    float spaceDbm = markLow ? pair.highDbm : pair.lowDbm;
+
+    result.shiftHz = pair.highHz - pair.lowHz;
+    result.markErrorHz = result.markHz - expectedMarkHz();
+    result.spaceErrorHz = result.spaceHz - expectedSpaceHz();
+    result.shiftErrorHz = result.shiftHz - expectedShiftHz();
+    result.powerRatioDb = markDbm - spaceDbm;
+    result.pass = qAbs(result.markErrorHz) <= m_toleranceHz
+               && qAbs(result.spaceErrorHz) <= m_toleranceHz
+               && qAbs(result.shiftErrorHz) <= m_toleranceHz;
+    return result;
+}
+
+/**
+ * @brief TxVerifier::findTonePair the strongest peak in the trace and the
+ * strongest other peak at least minSeparationHz away from it. Both must stand
+ * TXV_MIN_SNR_DB over the median, which is the noise floor as long as the
+ * tones cover less than half the span. Each peak is refined with a parabola
+ * through its bin and the two neighbours, in dB.
+ * @param trace amplitude per point in dBm, first point at startHz, last at
+ * stopHz
+ */
+TonePair TxVerifier::findTonePair(const QVector<float>& trace, double startHz, double stopHz,
+                                  double minSeparationHz){
+    TonePair pair = {};
+    int n = trace.size();
+    if(n < 3 || stopHz <= startHz){
+        return pair;
+    }
+    double binHz = (stopHz - startHz)/(n - 1);
+
+    QVector<float> sorted = trace;
+    std::nth_element(sorted.begin(), sorted.begin() + n/2, sorted.end());
+    float threshold = sorted[n/2] + (float)TXV_MIN_SNR_DB;
+
+    int first = -1;
+    int second = -1;
+    for(int i = 1; i < n - 1; i++){
+        if(trace[i] < threshold || trace[i] < trace[i - 1] || trace[i] <= trace[i + 1]){
+            continue;
+        }
+        if(first < 0 || trace[i] > trace[first]){
+            first = i;
+        }
+    }
+    if(first < 0){
+        return pair;
+    }
+    for(int i = 1; i < n - 1; i++){
+        if(trace[i] < threshold || trace[i] < trace[i - 1] || trace[i] <= trace[i + 1]){
+            continue;
+        }
+        if(qAbs(i - first)*binHz < minSeparationHz){
+            continue;
+        }
+        if(second < 0 || trace[i] > trace[second]){
+            second = i;
+        }
+    }
+    if(second < 0){
+        return pair;
+    }
+
+    auto refine = [&](int i, double* freq, float* dbm){
+        float a = trace[i - 1];
+        float b = trace[i];
+        float c = trace[i + 1];
+        float denom = a - 2.0f*b + c;
+        float delta = denom < 0.0f ? qBound(-0.5f, 0.5f*(a - c)/denom, 0.5f) : 0.0f;
+        *freq = startHz + (i + delta)*binHz;
+        *dbm = b - 0.25f*(a - c)*delta;
+    };
+    int low = qMin(first, second);
+    int high = qMax(first, second);
+    refine(low, &pair.lowHz, &pair.lowDbm);
+    refine(high, &pair.highHz, &pair.highDbm);
+    pair.valid = true;
+    return pair;
+}
@@ -0,0 +1,96 @@
+#ifndef TXVERIFIER_H
+#define TXVERIFIER_H
+
+#include <QVector>
+#include <QMetaType>
+
+#define TXV_SPAN_SHIFTS         4.0     // sweep span in multiples of the shift
+#define TXV_MIN_SPAN_HZ         1000.0
+#define TXV_MIN_SNR_DB          20.0    // peak above the trace median, clear of the floor's noise peaks
+#define TXV_MIN_SEPARATION      0.5     // of the shift, keeps both peaks off one tone
+#define TXV_TOLERANCE_HZ        10.0
+
+/*
+ * RBW. The parabola through a peak's three top points is exact for the
+ * analyzer's Gaussian filter in dB, so accuracy comes from the fit, not from
+ * a narrow filter, and sweep time falls with the square of the RBW. The
+ * upper limits: the tones must stay resolved (shift/TXV_RBW_DIV), and the
+ * filter must answer slower than two bits (baud/TXV_RBW_BITS). Then the
+ * mark/space alternation is mostly filtered out and each tone reads as a
+ * steady line about 6 dB down, whatever the keying phase when the sweep
+ * passes.
+ * The result is rounded down to the analyzer's 1-3-10 RBW steps.
+ */
+#define TXV_RBW_DIV             10.0
+#define TXV_RBW_BITS            2.0
+#define TXV_MIN_RBW_HZ          1.0
+
+/*
+ * With the keying filtered out as above, one max hold sweep sees both tones.
+ * Any further sweep would only fill in bins that are already there.
+ */
+#define TXV_SETTLE_SWEEPS       1
+
+/*
+ * Where the tones land on air relative to the carrier. With upper sideband
+ * keying mark is carrier + markFreq and space carrier + spaceFreq.
+ */
+#define TXV_TONE_SENSE          (1.0)
+
+struct TonePair {
+    bool valid;
+    double lowHz;
+    double highHz;
+    float lowDbm;
+    float highDbm;
+};
+
+struct TxVerifyResult {
+    bool pass;
+    bool found;
+    double markHz;          // measured on air
+    double spaceHz;
+    double shiftHz;
+    double markErrorHz;     // against the board's RttyState
+    double spaceErrorHz;
+    double shiftErrorHz;
+    double powerRatioDb;    // mark over space
+};
+Q_DECLARE_METATYPE(TxVerifyResult)
+
+/**
+ * @brief The TxVerifier class checks a keyed transmitter from a single
+ * analyzer trace. With the board alternating mark and space under a max hold
+ * trace both tones show up in one sweep; the two strongest peaks far enough
+ * apart are taken as the pair, refined to a fraction of a bin, and compared
+ * with the tones the board says it is sending.
+ */
+class TxVerifier
+{
+public:
+    TxVerifier();
+
+    void setExpected(double carrierHz, double markHz, double spaceHz, double baud);
+    void setTolerance(double toleranceHz) { m_toleranceHz = toleranceHz; }
+
+    double expectedMarkHz() const;
+    double expectedSpaceHz() const;
+    double expectedShiftHz() const;
+    double sweepStartHz() const;
+    double sweepStopHz() const;
+    double sweepRbwHz() const;
+
+    TxVerifyResult evaluate(const QVector<float>& trace, double startHz, double stopHz) const;
+
+    static TonePair findTonePair(const QVector<float>& trace, double startHz, double stopHz,
+                                 double minSeparationHz);
+
+private:
+    double m_carrierHz;
+    double m_markHz;
+    double m_spaceHz;
+    double m_baud;
+    double m_toleranceHz;
+};
+
+#endif // TXVERIFIER_H
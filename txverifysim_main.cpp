@@ -0,0 +1,110 @@
+#include <QCoreApplication>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QtMath>
+
+#include "txverifier.h"
+
+/*
+ * Runs TxVerifier against synthetic analyzer traces with known tone errors
+ * and checks that it recovers them.
+ *
+ *   RTTY_TxVerifySim [noiseDb]
+ *
+ * Each tone is drawn as the analyzer's Gaussian RBW filter would show it,
+ * TXSIM_KEYED_DB down for the alternating keying, over a noisy floor, on
+ * TXSIM_TRACE_POINTS points. Exits non-zero if any case misses.
+ */
+
+#define TXSIM_TRACE_POINTS      751     // SSA3000X sweep points
+#define TXSIM_TONE_DBM          -20.0
+#define TXSIM_KEYED_DB          -6.0    // half duty keying through the RBW filter
+#define TXSIM_FLOOR_DBM         -90.0
+#define TXSIM_MAX_MISS_HZ       0.5     // recovered error against the one put in
+
+struct SimCase {
+    QString name;
+    double markHz;
+    double spaceHz;
+    double baud;
+    double markErrHz;       // put into the trace
+    double spaceErrHz;
+    bool bothTones;
+};
+
+static QVector<float> makeTrace(const TxVerifier& verifier, const SimCase& c, double noiseDb,
+                                QRandomGenerator* rng){
+    double start = verifier.sweepStartHz();
+    double stop = verifier.sweepStopHz();
+    double rbw = verifier.sweepRbwHz();
+    double binHz = (stop - start)/(TXSIM_TRACE_POINTS - 1);
+    double mark = verifier.expectedMarkHz() + c.markErrHz;
+    double space = verifier.expectedSpaceHz() + c.spaceErrHz;
+    double level = TXSIM_TONE_DBM + TXSIM_KEYED_DB;
+
+    QVector<float> trace(TXSIM_TRACE_POINTS);
+    for(int i = 0; i < trace.size(); i++){
+        double f = start + i*binHz;
+        // Gaussian filter, 3 dB down at +/- rbw/2
+        double markDbm = level - 3.01*qPow((f - mark)/(rbw/2.0), 2.0);
+        double spaceDbm = level - 3.01*qPow((f - space)/(rbw/2.0), 2.0);
+        double u1 = qMax(rng->generateDouble(), 1.0e-12);
+        double u2 = rng->generateDouble();
+        double floorDbm = TXSIM_FLOOR_DBM + noiseDb*qSqrt(-2.0*qLn(u1))*qCos(2.0*M_PI*u2);
+
+        double mw = qPow(10.0, floorDbm/10.0) + qPow(10.0, markDbm/10.0);
+        if(c.bothTones){
+            mw += qPow(10.0, spaceDbm/10.0);
+        }
+        trace[i] = (float)(10.0*std::log10(mw));
+    }
+    return trace;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    QStringList args = a.arguments();
+    double noiseDb = args.length() > 1 ? args[1].toDouble() : 1.5;
+
+    QList<SimCase> cases = {
+        {"170 Hz, 45.45 bd", 2125.0, 2295.0, 45.45, 3.3, -1.7, true},
+        {"170 Hz, 75 bd", 2125.0, 2295.0, 75.0, -4.0, 6.5, true},
+        {"425 Hz, 50 bd", 1275.0, 1700.0, 50.0, 0.0, 8.0, true},
+        {"850 Hz, 45.45 bd", 2125.0, 2975.0, 45.45, -7.5, 2.2, true},
+        {"mark only", 2125.0, 2295.0, 45.45, 0.0, 0.0, false},
+    };
+
+    QRandomGenerator rng(1);
+    QTextStream out(stdout);
+    out << QString("floor noise %1 dB, %2 trace points\n").arg(noiseDb).arg(TXSIM_TRACE_POINTS);
+    out << "case               rbw (Hz)  bin (Hz)  mark in/out (Hz)   space in/out (Hz)  result\n";
+    int failed = 0;
+    for(const auto& c : cases){
+        TxVerifier verifier;
+        verifier.setExpected(14.08e6, c.markHz, c.spaceHz, c.baud);
+        QVector<float> trace = makeTrace(verifier, c, noiseDb, &rng);
+        TxVerifyResult r = verifier.evaluate(trace, verifier.sweepStartHz(), verifier.sweepStopHz());
+
+        bool ok;
+        if(c.bothTones){
+            ok = r.found && qAbs(r.markErrorHz - c.markErrHz) <= TXSIM_MAX_MISS_HZ
+                         && qAbs(r.spaceErrorHz - c.spaceErrHz) <= TXSIM_MAX_MISS_HZ;
+        }else{
+            ok = !r.found;
+        }
+        failed += ok ? 0 : 1;
+
+        double binHz = (verifier.sweepStopHz() - verifier.sweepStartHz())/(TXSIM_TRACE_POINTS - 1);
+        out << QString("%1 %2 %3 %4 / %5 %6 / %7 %8\n")
+                   .arg(c.name, -18)
+                   .arg(verifier.sweepRbwHz(), 8, 'f', 0)
+                   .arg(binHz, 9, 'f', 2)
+                   .arg(c.markErrHz, 8, 'f', 2)
+                   .arg(r.found ? QString::number(r.markErrorHz, 'f', 2) : QString("-"), -8)
+                   .arg(c.spaceErrHz, 8, 'f', 2)
+                   .arg(r.found ? QString::number(r.spaceErrorHz, 'f', 2) : QString("-"), -8)
+                   .arg(ok ? "ok" : "MISS");
+    }
+    return failed == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include "vcocalcurve.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QStringList>
+#include <algorithm>
+#include <cstring>
+
+VcoCalCurve::VcoCalCurve()
+{
+
+}
+
+void VcoCalCurve::clear(){
+    m_points.clear();
+}
+
+/**
+ * @brief VcoCalCurve::addPoint insert a measured point, keeping the curve
+ * sorted by voltage. A repeat measurement at the same voltage replaces the
+ * old one.
+ */
+void VcoCalCurve::addPoint(double voltage, double freq){
+    auto it = std::lower_bound(m_points.begin(), m_points.end(), voltage,
+                               [](const VcoCalPoint& p, double v){ return p.voltage < v; });
+    if(it != m_points.end() && qAbs(it->voltage - voltage) < 1.0e-6){
+        it->freq = freq;
+        return;
+    }
+    m_points.insert(it, {voltage, freq});
+}
+
+double VcoCalCurve::freqAt(double voltage) const{
+    if(m_points.isEmpty()){
+        return 0.0;
+    }
+    if(!isValid()){
+        return m_points[0].freq;
+    }
+    int i = segmentFor(voltage);
+    const VcoCalPoint& a = m_points[i];
+    const VcoCalPoint& b = m_points[i + 1];
+    return a.freq + (voltage - a.voltage)*(b.freq - a.freq)/(b.voltage - a.voltage);
+}
+
+/**
+ * @brief VcoCalCurve::slopeAt tuning sensitivity around voltage
+ * @return Hz per volt, 0 if the curve has fewer than two points
+ */
+double VcoCalCurve::slopeAt(double voltage) const{
+    if(!isValid()){
+        return 0.0;
+    }
+    int i = segmentFor(voltage);
+    const VcoCalPoint& a = m_points[i];
+    const VcoCalPoint& b = m_points[i + 1];
+    return (b.freq - a.freq)/(b.voltage - a.voltage);
+}
+
+/**
+ * @brief VcoCalCurve::segmentFor index of the first point of the segment
+ * containing voltage, clamped to the ends of the curve
+ */
+int VcoCalCurve::segmentFor(double voltage) const{
+    auto it = std::upper_bound(m_points.begin(), m_points.end(), voltage,
+                               [](double v, const VcoCalPoint& p){ return v < p.voltage; });
+    int i = (int)(it - m_points.begin()) - 1;
+    return qBound(0, i, m_points.length() - 2);
+}
+
+bool VcoCalCurve::save(const QString& path) const{
+    QFile file(path);
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Text)){
+        return false;
+    }
+    QTextStream out(&file);
+    out << "voltage,freq\n";
+    for(const auto& p : m_points){
+        out << QString::number(p.voltage, 'f', 6) << "," << QString::number(p.freq, 'f', 1) << "\n";
+    }
+    return true;
+}
+
+/**
+ * @brief VcoCalCurve::toTable the curve as the binary table the board looks
+ * up in, for RttyBoard::uploadTable
+ */
+QByteArray VcoCalCurve::toTable() const{
+    int count = qMin(m_points.length(), 0xFFFF);
+    QByteArray table(VCO_TABLE_HEADER_LEN + count*VCO_TABLE_POINT_LEN, 0x00);
+    char* raw = table.data();
+    raw[0] = VCO_TABLE_FORMAT;
+    uint16_t n = (uint16_t)count;
+    memcpy(raw + 2, &n, 2);
+    raw += VCO_TABLE_HEADER_LEN;
+    for(int i = 0; i < count; i++){
+        float v = (float)m_points[i].voltage;
+        uint32_t f = (uint32_t)qRound64(m_points[i].freq*VCO_TABLE_FREQ_SCALE);
+        memcpy(raw, &v, 4);
+        memcpy(raw + 4, &f, 4);
+        raw += VCO_TABLE_POINT_LEN;
+    }
+    return table;
+}
+
+/**
+ * @brief VcoCalCurve::load read a curve written by save()
+ * @return false if the file couldn't be read or didn't hold a usable curve
+ * of at least two points, in which case the current curve is kept
+ */
+bool VcoCalCurve::load(const QString& path){
+    QFile file(path);
+    if(!file.open(QIODevice::ReadOnly | QIODevice::Text)){
+        return false;
+    }
+    VcoCalCurve loaded;
+    QTextStream in(&file);
+    in.readLine(); // header
+    while(!in.atEnd()){
+        QStringList cols = in.readLine().split(',');
+        if(cols.length() != 2){
+            continue;
+        }
+        bool okV = false;
+        bool okF = false;
+        double v = cols[0].toDouble(&okV);
+        double f = cols[1].toDouble(&okF);
+        if(okV && okF){
+            loaded.addPoint(v, f);
+        }
+    }
+    if(!loaded.isValid()){
+        return false;
+    }
+    m_points = loaded.m_points;
+    return true;
+}
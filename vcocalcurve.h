@@ -0,0 +1,55 @@
+#ifndef VCOCALCURVE_H
+#define VCOCALCURVE_H
+
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+#include <inttypes.h>
+
+/*
+ * Board table image, little endian
+ *
+ *  [u8 format][u8 reserved][u16 count] then count x [f32 voltage][u32 freq]
+ *
+ * freq is in units of 1/VCO_TABLE_FREQ_SCALE Hz.
+ */
+#define VCO_TABLE_FORMAT        1
+#define VCO_TABLE_HEADER_LEN    4
+#define VCO_TABLE_POINT_LEN     8
+#define VCO_TABLE_FREQ_SCALE    10.0
+
+struct VcoCalPoint {
+    double voltage;
+    double freq;
+};
+
+/**
+ * @brief The VcoCalCurve class holds the measured VCO tuning curve, DAC
+ * voltage to output frequency, as built up point by point during calibration.
+ * Lookups interpolate linearly between the neighbouring points.
+ */
+class VcoCalCurve
+{
+public:
+    VcoCalCurve();
+
+    void clear();
+    void addPoint(double voltage, double freq);
+    bool isValid() const { return m_points.length() >= 2; }
+    int count() const { return m_points.length(); }
+    const QVector<VcoCalPoint>& points() const { return m_points; }
+
+    double freqAt(double voltage) const;
+    double slopeAt(double voltage) const;
+
+    bool save(const QString& path) const;
+    bool load(const QString& path);
+
+    QByteArray toTable() const;
+
+private:
+    int segmentFor(double voltage) const;
+    QVector<VcoCalPoint> m_points;
+};
+
+#endif // VCOCALCURVE_H
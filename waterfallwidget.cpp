@@ -0,0 +1,107 @@
+#include "waterfallwidget.h"
+#include <QPainter>
+
+WaterfallWidget::WaterfallWidget(QWidget *parent)
+    : QWidget{parent}
+{
+    m_head = 0;
+    m_rows = 0;
+    m_palette = buildPalette();
+    setLevelRange(WATERFALL_MIN_DBM, WATERFALL_MAX_DBM);
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    resizeImage(1);
+}
+
+/**
+ * @brief WaterfallWidget::addTrace add one sweep as the newest row
+ * @param trace amplitude per trace point in dBm
+ */
+void WaterfallWidget::addTrace(QVector<float> trace){
+    if(trace.isEmpty()){
+        return;
+    }
+    if(trace.length() != m_image.width()){
+        resizeImage(trace.length());
+    }
+
+    m_head = (m_head + WATERFALL_HISTORY - 1) % WATERFALL_HISTORY;
+    QRgb* line = (QRgb*)m_image.scanLine(m_head);
+    const float* src = trace.constData();
+    const QRgb* palette = m_palette.constData();
+    for(int i = 0; i < trace.length(); i++){
+        float idx = (src[i] - m_minDbm)*m_scale;
+        line[i] = palette[idx <= 0.0f ? 0 : (idx >= 255.0f ? 255 : (int)idx)];
+    }
+    if(m_rows < WATERFALL_HISTORY){
+        m_rows++;
+    }
+    update();
+}
+
+void WaterfallWidget::setLevelRange(float minDbm, float maxDbm){
+    m_minDbm = minDbm;
+    m_scale = maxDbm > minDbm ? 255.0f/(maxDbm - minDbm) : 1.0f;
+}
+
+void WaterfallWidget::clear(){
+    m_image.fill(m_palette[0]);
+    m_head = 0;
+    m_rows = 0;
+    update();
+}
+
+void WaterfallWidget::paintEvent(QPaintEvent *event){
+    Q_UNUSED(event);
+    QPainter painter(this);
+    painter.fillRect(rect(), Qt::black);
+    if(m_rows == 0){
+        return;
+    }
+
+    // one screen row per history row, newest at the top
+    double rowHeight = (double)height()/(double)WATERFALL_HISTORY;
+    int firstLen = qMin(m_rows, WATERFALL_HISTORY - m_head);
+    int secondLen = m_rows - firstLen;
+
+    QRectF top(0.0, 0.0, width(), firstLen*rowHeight);
+    painter.drawImage(top, m_image, QRectF(0, m_head, m_image.width(), firstLen));
+    if(secondLen > 0){
+        QRectF bottom(0.0, firstLen*rowHeight, width(), secondLen*rowHeight);
+        painter.drawImage(bottom, m_image, QRectF(0, 0, m_image.width(), secondLen));
+    }
+}
+
+void WaterfallWidget::resizeImage(int width){
+    m_image = QImage(width, WATERFALL_HISTORY, QImage::Format_RGB32);
+    m_image.fill(m_palette[0]);
+    m_head = 0;
+    m_rows = 0;
+}
+
+/**
+ * @brief WaterfallWidget::buildPalette 256 entry black-blue-cyan-yellow-red-white ramp
+ */
+QVector<QRgb> WaterfallWidget::buildPalette(){
+    static const QRgb stops[] = {
+        qRgb(0, 0, 0),
+        qRgb(0, 0, 160),
+        qRgb(0, 200, 255),
+        qRgb(255, 255, 0),
+        qRgb(255, 0, 0),
+        qRgb(255, 255, 255)
+    };
+    const int numStops = sizeof(stops)/sizeof(stops[0]);
+
+    QVector<QRgb> palette(256);
+    for(int i = 0; i < 256; i++){
+        double pos = (double)i/255.0*(numStops - 1);
+        int lo = qMin((int)pos, numStops - 2);
+        double t = pos - lo;
+        QRgb a = stops[lo];
+        QRgb b = stops[lo + 1];
+        palette[i] = qRgb((int)(qRed(a) + t*(qRed(b) - qRed(a))),
+                          (int)(qGreen(a) + t*(qGreen(b) - qGreen(a))),
+                          (int)(qBlue(a) + t*(qBlue(b) - qBlue(a))));
+    }
+    return palette;
+}
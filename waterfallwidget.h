@@ -0,0 +1,45 @@
+#ifndef WATERFALLWIDGET_H
+#define WATERFALLWIDGET_H
+
+#include <QWidget>
+#include <QImage>
+#include <QVector>
+
+#define WATERFALL_HISTORY   512
+#define WATERFALL_MIN_DBM   -110.0f
+#define WATERFALL_MAX_DBM   10.0f
+
+/**
+ * @brief The WaterfallWidget class scrolls analyzer traces down the screen.
+ * Rows go into a circular RGB32 image, coloured through the palette once as
+ * each trace arrives, so nothing already drawn is ever touched again and
+ * painting needs no format conversion. Painting is two blits: newest rows
+ * down to the wrap point, then the rest.
+ */
+class WaterfallWidget : public QWidget
+{
+    Q_OBJECT
+public:
+    explicit WaterfallWidget(QWidget *parent = nullptr);
+
+public slots:
+    void addTrace(QVector<float> trace);
+    void setLevelRange(float minDbm, float maxDbm);
+    void clear();
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+
+private:
+    void resizeImage(int width);
+    static QVector<QRgb> buildPalette();
+
+    QImage m_image;
+    QVector<QRgb> m_palette;
+    int m_head;
+    int m_rows;
+    float m_minDbm;
+    float m_scale;
+};
+
+#endif // WATERFALLWIDGET_H